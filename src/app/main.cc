@@ -1,8 +1,17 @@
+#include <iostream>
+
 #include "particle_sim_app.h"
 
-int main()
+int main(int argc, char** argv)
 {
-    ParticleSimApp app;
+    ParticleSimApp::Config config;
+    if (!ParticleSimApp::parseArgs(argc, argv, config))
+    {
+        std::cerr << "Usage: ParticleSimulation [--pipelined] [--snapshot PATH] [--record PATH] [--replay PATH] [--substeps N] [--no-sleep] [--profile PATH]\n";
+        return 1;
+    }
+
+    ParticleSimApp app{config};
     app.Run();
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,204 @@
-#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "common/utils.h"
 #include "physics/particle_manager.h"
+#include "physics/snapshot.h"
+#include "physics/substep_scheduler.h"
+#include "physics/trajectory.h"
 #include "render/renderer.h"
 
+#include "simulation_thread.h"
 #include "particle_sim_app.h"
 
+bool ParticleSimApp::parseArgs(int argc, char** argv, Config& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--pipelined")
+        {
+            config.pipelined = true;
+        }
+        else if (arg == "--no-sleep")
+        {
+            config.sleep = false;
+        }
+        else if (arg == "--snapshot" && i + 1 < argc)
+        {
+            config.snapshot_path = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            config.record_path = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            config.replay_path = argv[++i];
+        }
+        else if (arg == "--profile" && i + 1 < argc && sim::PROFILING_ENABLED)
+        {
+            config.profile_path = argv[++i];
+        }
+        else if (arg == "--substeps" && i + 1 < argc)
+        {
+            config.substeps = std::atoi(argv[++i]);
+            if (config.substeps < 1)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::optional<sim::ResizeDirection> ParticleSimApp::resizeDirection(const sf::Event& event)
+{
+    if (event.type != sf::Event::KeyPressed)
+    {
+        return std::nullopt;
+    }
+
+    switch (event.key.code)
+    {
+        case sf::Keyboard::Up    : return sim::ResizeDirection::Up;
+        case sf::Keyboard::Right : return sim::ResizeDirection::Right;
+        case sf::Keyboard::Down  : return sim::ResizeDirection::Down;
+        case sf::Keyboard::Left  : return sim::ResizeDirection::Left;
+        default: return std::nullopt;
+    }
+}
+
+bool ParticleSimApp::isFill(const sf::Event& event)
+{
+    return event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F;
+}
+
+sim::Emitter::Settings ParticleSimApp::fillEmitter(const sim::Container& container)
+{
+    const auto& [x_bounds, y_bounds] = container.getBounds();
+    sim::Emitter::Settings settings;
+    settings.shape = sim::EmitterShape::Area;
+    settings.position = sim::Vec2f{x_bounds[0], y_bounds[0]};
+    settings.extent = sim::Vec2f{x_bounds[1] - x_bounds[0], 0.5f * (y_bounds[1] - y_bounds[0])};
+    settings.min_radius = 3.0f;
+    settings.max_radius = 10.0f;
+    return settings;
+}
+
+ParticleSimApp::ParticleSimApp(const Config& config)
+    : config_{config}
+{
+}
+
+void ParticleSimApp::toggleProfile(const sf::Event& event)
+{
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3)
+    {
+        show_profile_ = !show_profile_;
+    }
+}
+
+void ParticleSimApp::presentFrame(sf::RenderWindow& window, sim::Renderer& renderer, size_t particles,
+                                  const sim::FrameProfile* physics)
+{
+    if (show_profile_ && sim::PROFILING_ENABLED)
+    {
+        renderer.drawProfile(last_profile_);
+    }
+
+    {
+        PARTICLESIM_PROFILE_SCOPE(sim::ProfileZone::Present);
+        window.display();
+    }
+
+    if (sim::PROFILING_ENABLED)
+    {
+        if (physics)
+        {
+            // The physics runs on its own thread, so its figures come from the simulation frame that was drawn
+            last_profile_ = sim::Profiler::instance().endFrame(sim::RENDER_ZONES, false);
+            for (const auto zone : sim::PHYSICS_ZONES)
+            {
+                last_profile_.zone_ns[static_cast<size_t>(zone)] = physics->zone_ns[static_cast<size_t>(zone)];
+            }
+            last_profile_.counts = physics->counts;
+        }
+        else
+        {
+            last_profile_ = sim::Profiler::instance().endFrame();
+        }
+
+        if (profile_out_.is_open())
+        {
+            sim::writeProfileRow(profile_out_, last_profile_, particles);
+        }
+    }
+}
+
+std::string ParticleSimApp::makeTitle(size_t count, double avg_speed, int substeps)
+{
+    // Set title with particle count, the average speed of the particles and the substeps of the last frame
+    std::string title = "Particles: " + std::to_string(count);
+    title += " | Avg Speed: ";
+    title += std::to_string(std::round(avg_speed * 1000.0) / 1000.0);
+    if (substeps > 0)
+    {
+        title += " | Substeps: " + std::to_string(substeps);
+    }
+    return title;
+}
+
 void ParticleSimApp::Run()
 {
     sf::RenderWindow window{sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Particle Simulation", sf::Style::Titlebar | sf::Style::Close};
+    window.setFramerateLimit(TARGET_FPS);
+
+    if (!config_.profile_path.empty())
+    {
+        profile_out_.open(config_.profile_path);
+        if (!profile_out_)
+        {
+            std::cerr << "Could not open " << config_.profile_path << " for the profile\n";
+        }
+        else
+        {
+            sim::writeProfileHeader(profile_out_);
+        }
+    }
+
+    try
+    {
+        if (!config_.replay_path.empty())
+        {
+            RunReplay(window);
+        }
+        else if (config_.pipelined)
+        {
+            RunPipelined(window);
+        }
+        else
+        {
+            RunSynchronous(window);
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << "\n";
+    }
+}
+
+void ParticleSimApp::RunSynchronous(sf::RenderWindow& window)
+{
     sim::Container container{WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2};
 
     // Center the container
@@ -16,8 +206,18 @@ void ParticleSimApp::Run()
 
     sim::Renderer renderer{window};
     sim::ParticleManager manager{container};
+    sim::SubstepScheduler scheduler;
+
+    sim::SleepSettings sleep;
+    sleep.enabled = config_.sleep;
+    manager.setSleepSettings(sleep);
+
+    std::unique_ptr<sim::TrajectoryRecorder> recorder;
+    if (!config_.record_path.empty())
+    {
+        recorder = std::make_unique<sim::TrajectoryRecorder>(config_.record_path);
+    }
 
-    window.setFramerateLimit(TARGET_FPS);
     bool left_mouse_held = false;
 
     while (window.isOpen())
@@ -28,6 +228,8 @@ void ParticleSimApp::Run()
             if (event.type == sf::Event::Closed)
                 window.close();
 
+            toggleProfile(event);
+
             // Detect dragging
             if (sf::Mouse::isButtonPressed(sf::Mouse::Left))
             {
@@ -43,6 +245,38 @@ void ParticleSimApp::Run()
             {
                 manager.clear();
             }
+
+            // The manager notices the new bounds on its next step
+            if (const auto direction = resizeDirection(event))
+            {
+                container.handleResize(*direction);
+            }
+
+            if (isFill(event))
+            {
+                std::vector<sim::ParticleSpawn> batch;
+                sim::Emitter{fillEmitter(container)}.burst(FILL_COUNT, manager.random(), batch);
+                manager.spawn(batch);
+            }
+
+            if (event.type == sf::Event::KeyPressed && (event.key.code == sf::Keyboard::F5 || event.key.code == sf::Keyboard::F9))
+            {
+                try
+                {
+                    if (event.key.code == sf::Keyboard::F5)
+                    {
+                        sim::saveSnapshot(config_.snapshot_path, manager);
+                    }
+                    else
+                    {
+                        sim::loadSnapshot(config_.snapshot_path, manager);
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << e.what() << "\n";
+                }
+            }
         }
 
         if (left_mouse_held)
@@ -51,36 +285,194 @@ void ParticleSimApp::Run()
 
             if (container.intersects(x, y))
             {
-                const auto& particle = manager.createParticleAtCursor(x, y);
-                renderer.drawParticle(particle);
+                manager.createParticleAtCursor(x, y);
             }
         }
 
-        for (uint8_t i = SUBSTEPS; i > 0; i--)
+        const int substeps = config_.substeps > 0 ? config_.substeps : scheduler.next(manager, TIMESTEP);
+        const float dt = TIMESTEP / static_cast<float>(substeps);
+        for (int i = substeps; i > 0; i--)
         {
             manager.updateParticles(dt);
         }
 
-        window.clear();
+        if (recorder)
+        {
+            // A failed recording ends the recording, not the simulation
+            try
+            {
+                recorder->record(manager.particles(), manager.container(), manager.stepCount());
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << "\n";
+                recorder.reset();
+            }
+        }
 
-        renderer.drawContainer(container);
+        window.clear();
 
-        for (const auto& particle : manager.particles())
         {
-            renderer.drawParticle(particle);
+            PARTICLESIM_PROFILE_SCOPE(sim::ProfileZone::Draw);
+            renderer.drawContainer(container);
+            renderer.drawParticles(manager.particles());
         }
 
-        // Set title with particle count and the average speed of the particles
         const auto count = manager.particle_count();
-        std::string title = "Particles: " + std::to_string(count);
-        title += " | Avg Speed: ";
+        window.setTitle(makeTitle(count, manager.statistics().meanSpeed(), substeps));
 
-        auto cumulative_speed = [](double s, const sim::Particle& p) -> double { return s + p.velocity().magnitude(); };
-        const double avg_speed = std::accumulate(manager.particles().begin(), manager.particles().end(), 0.0, cumulative_speed) / static_cast<double>(count);
-        title += std::to_string(std::round(avg_speed * 1000.0) / 1000.0);
+        presentFrame(window, renderer, count);
+    }
+}
 
-        window.setTitle(title);
+void ParticleSimApp::RunPipelined(sf::RenderWindow& window)
+{
+    sim::Container container{WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2};
 
-        window.display();
+    // Center the container
+    container.centerInside({0.0f, static_cast<float>(WINDOW_WIDTH)}, {0.0f, static_cast<float>(WINDOW_HEIGHT)});
+
+    sim::Renderer renderer{window};
+    sim::SleepSettings sleep;
+    sleep.enabled = config_.sleep;
+    SimulationThread simulation{container, TIMESTEP, config_.substeps, sleep, config_.record_path};
+    simulation.start();
+
+    bool left_mouse_held = false;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            toggleProfile(event);
+
+            // Detect dragging
+            if (sf::Mouse::isButtonPressed(sf::Mouse::Left))
+            {
+                left_mouse_held = true;
+            }
+
+            if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+            {
+                left_mouse_held = false;
+            }
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R)
+            {
+                simulation.clear();
+            }
+
+            if (const auto direction = resizeDirection(event))
+            {
+                simulation.resize(*direction);
+            }
+
+            if (isFill(event))
+            {
+                simulation.burst(fillEmitter(simulation.latestSnapshot().container), FILL_COUNT);
+            }
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F5)
+            {
+                simulation.save(config_.snapshot_path);
+            }
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F9)
+            {
+                simulation.load(config_.snapshot_path);
+            }
+        }
+
+        // Everything below reads the snapshot only, the live simulation belongs to the simulation thread
+        const auto& snapshot = simulation.latestSnapshot();
+
+        if (left_mouse_held)
+        {
+            auto [x, y] = window.mapPixelToCoords(sf::Mouse::getPosition(window));
+
+            if (snapshot.container.intersects(x, y))
+            {
+                simulation.spawnAt(x, y);
+            }
+        }
+
+        window.clear();
+
+        {
+            PARTICLESIM_PROFILE_SCOPE(sim::ProfileZone::Draw);
+            renderer.drawContainer(snapshot.container);
+            renderer.drawParticles(snapshot);
+        }
+
+        window.setTitle(makeTitle(snapshot.particle_count(), snapshot.stats.meanSpeed(), snapshot.substeps));
+
+        presentFrame(window, renderer, snapshot.particle_count(), &snapshot.profile);
+    }
+
+    simulation.stop();
+}
+void ParticleSimApp::RunReplay(sf::RenderWindow& window)
+{
+    sim::Renderer renderer{window};
+    sim::TrajectoryReader reader{config_.replay_path};
+    sim::TrajectoryFrame frame;
+
+    if (!reader.next(frame))
+    {
+        throw std::runtime_error(config_.replay_path + " does not hold any frames");
+    }
+
+    bool paused = false;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            toggleProfile(event);
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space)
+            {
+                paused = !paused;
+            }
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R)
+            {
+                reader.rewind();
+                reader.next(frame);
+            }
+        }
+
+        // One recorded frame per displayed frame, holding on the last one once the recording ends
+        if (!paused)
+        {
+            reader.next(frame);
+        }
+
+        window.clear();
+
+        {
+            PARTICLESIM_PROFILE_SCOPE(sim::ProfileZone::Draw);
+            renderer.drawContainer(frame.container);
+            renderer.drawParticles(frame.pos_x, frame.pos_y, frame.radius);
+        }
+
+        double cumulative_speed = 0.0;
+        for (size_t i = 0; i < frame.particle_count(); ++i)
+        {
+            cumulative_speed += sim::Vec2f{frame.vel_x[i], frame.vel_y[i]}.magnitude();
+        }
+
+        const double avg_speed = frame.particle_count() > 0 ? cumulative_speed / static_cast<double>(frame.particle_count()) : 0.0;
+        window.setTitle(makeTitle(frame.particle_count(), avg_speed) + " | Step: " + std::to_string(frame.step));
+
+        presentFrame(window, renderer, frame.particle_count());
     }
-}
\ No newline at end of file
+}
@@ -1,17 +1,83 @@
 #pragma once
+#include <fstream>
+#include <optional>
+#include <string>
+
 #include <SFML/Graphics.hpp>
 
+#include "common/profiler.h"
+#include "physics/container.h"
+#include "physics/emitter.h"
+
+namespace sim {
+class Renderer;
+}
+
 class ParticleSimApp
 {
 public:
+    struct Config
+    {
+        // Step the simulation on its own thread and draw the latest completed frame
+        bool pipelined = false;
+
+        // F5 saves the simulation here and F9 restores it
+        std::string snapshot_path = "particles.snapshot";
+
+        // Stream every frame to this trajectory file, if set
+        std::string record_path;
+
+        // Play back a recorded trajectory instead of running the simulation, if set
+        std::string replay_path;
+
+        // Fixed substeps per frame, 0 lets SubstepScheduler choose them frame by frame
+        int substeps = 0;
+
+        // Put particles that have come to rest to sleep, --no-sleep keeps every particle simulated
+        bool sleep = true;
+
+        // Write per-frame phase timings and counters here as CSV, profiling builds only
+        std::string profile_path;
+    };
+
+    static bool parseArgs(int argc, char** argv, Config& config);
+
+    ParticleSimApp() = default;
+    explicit ParticleSimApp(const Config& config);
+
     void Run();
 
 private:
+    void RunSynchronous(sf::RenderWindow& window);
+    void RunPipelined(sf::RenderWindow& window);
+    void RunReplay(sf::RenderWindow& window);
+
+    static std::string makeTitle(size_t count, double avg_speed, int substeps = 0);
+
+    // Draws the profiling overlay if it is on, shows the frame and closes its profile. In pipelined mode the physics
+    // zones and counters come from physics, the profile the simulation thread published with the drawn snapshot.
+    void presentFrame(sf::RenderWindow& window, sim::Renderer& renderer, size_t particles,
+                      const sim::FrameProfile* physics = nullptr);
+    void toggleProfile(const sf::Event& event);
+
+    // The arrow keys resize the container: up and right grow it, down and left shrink it
+    static std::optional<sim::ResizeDirection> resizeDirection(const sf::Event& event);
+
+    // F pours FILL_COUNT particles of mixed sizes over the top half of the container
+    static bool isFill(const sf::Event& event);
+    static sim::Emitter::Settings fillEmitter(const sim::Container& container);
+
+    Config config_;
+
+    // F3 toggles the overlay, which shows the profile of the frame before the current one
+    bool show_profile_{sim::PROFILING_ENABLED};
+    sim::FrameProfile last_profile_;
+    std::ofstream profile_out_;
+
     static constexpr int TARGET_FPS = 60;
     static constexpr int WINDOW_WIDTH = 1920;
     static constexpr int WINDOW_HEIGHT = 1080;
 
     static constexpr float TIMESTEP = 1.0f / TARGET_FPS;
-    static constexpr uint8_t SUBSTEPS = 16;
-    static constexpr float dt = TIMESTEP / static_cast<float>(SUBSTEPS);
+    static constexpr size_t FILL_COUNT = 10000;
 };
\ No newline at end of file
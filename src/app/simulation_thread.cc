@@ -0,0 +1,192 @@
+#include <chrono>
+#include <iostream>
+
+#include "physics/snapshot.h"
+
+#include "simulation_thread.h"
+
+SimulationThread::SimulationThread(const sim::Container& container, float frame_time, int substeps, const sim::SleepSettings& sleep,
+                                   const std::string& record_path)
+    : container_{container}
+    , manager_{container_}
+    , frame_time_{frame_time}
+    , substeps_{substeps}
+{
+    manager_.setSleepSettings(sleep);
+
+    if (!record_path.empty())
+    {
+        recorder_ = std::make_unique<sim::TrajectoryRecorder>(record_path);
+    }
+
+    // Give the renderer something to draw before the first frame has been stepped
+    publishSnapshot();
+    snapshots_.update();
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (running_.exchange(true))
+    {
+        return;
+    }
+
+    thread_ = std::thread{[this] { run(); }};
+}
+
+void SimulationThread::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void SimulationThread::spawnAt(float x, float y)
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Spawn, x, y});
+}
+
+void SimulationThread::clear()
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Clear});
+}
+
+void SimulationThread::save(const std::string& path)
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Save, 0.0f, 0.0f, path});
+}
+
+void SimulationThread::load(const std::string& path)
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Load, 0.0f, 0.0f, path});
+}
+
+void SimulationThread::resize(sim::ResizeDirection direction)
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Resize, 0.0f, 0.0f, {}, direction});
+}
+
+void SimulationThread::burst(const sim::Emitter::Settings& emitter, size_t count)
+{
+    std::lock_guard lock{commands_mutex_};
+    commands_.push_back(Command{Command::Type::Burst, 0.0f, 0.0f, {}, sim::ResizeDirection::Up, emitter, count});
+}
+
+const sim::FrameSnapshot& SimulationThread::latestSnapshot()
+{
+    snapshots_.update();
+    return snapshots_.readBuffer();
+}
+
+void SimulationThread::run()
+{
+    using clock = std::chrono::steady_clock;
+    const auto frame_duration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(frame_time_));
+    auto next_frame = clock::now();
+    while (running_)
+    {
+        applyCommands();
+
+        last_substeps_ = substeps_ > 0 ? substeps_ : scheduler_.next(manager_, frame_time_);
+        const float dt = frame_time_ / static_cast<float>(last_substeps_);
+        for (int i = last_substeps_; i > 0; i--)
+        {
+            manager_.updateParticles(dt);
+        }
+
+        ++frame_;
+        if (sim::PROFILING_ENABLED)
+        {
+            profile_ = sim::Profiler::instance().take(sim::PHYSICS_ZONES, true);
+            profile_.frame = frame_;
+        }
+        publishSnapshot();
+
+        if (recorder_)
+        {
+            // A failed recording ends the recording, not the simulation
+            try
+            {
+                recorder_->record(manager_.particles(), container_, manager_.stepCount());
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << "\n";
+                recorder_.reset();
+            }
+        }
+
+        // Keep simulated time in step with wall time, but never try to catch up after a slow frame
+        next_frame += frame_duration;
+        const auto now = clock::now();
+        if (next_frame > now)
+        {
+            std::this_thread::sleep_until(next_frame);
+        }
+        else
+        {
+            next_frame = now;
+        }
+    }
+}
+
+void SimulationThread::applyCommands()
+{
+    {
+        std::lock_guard lock{commands_mutex_};
+        pending_commands_.swap(commands_);
+    }
+
+    for (const auto& command : pending_commands_)
+    {
+        try
+        {
+            switch (command.type)
+            {
+                case Command::Type::Spawn : manager_.createParticleAtCursor(command.x, command.y); break;
+                case Command::Type::Clear : manager_.clear(); break;
+                case Command::Type::Save  : sim::saveSnapshot(command.path, manager_); break;
+                case Command::Type::Load  : sim::loadSnapshot(command.path, manager_); break;
+                case Command::Type::Resize: container_.handleResize(command.direction); break;
+                case Command::Type::Burst :
+                {
+                    sim::Emitter emitter{command.emitter};
+                    spawn_batch_.clear();
+                    emitter.burst(command.count, manager_.random(), spawn_batch_);
+                    manager_.spawn(spawn_batch_);
+                    break;
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+        }
+    }
+
+    pending_commands_.clear();
+}
+
+void SimulationThread::publishSnapshot()
+{
+    auto& snapshot = snapshots_.writeBuffer();
+    snapshot.capture(manager_.particles(), container_);
+    snapshot.frame = frame_;
+    snapshot.substeps = last_substeps_;
+    snapshot.stats = manager_.statistics();
+    snapshot.profile = profile_;
+
+    snapshots_.publish();
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/triple_buffer.h"
+#include "physics/particle_manager.h"
+#include "physics/substep_scheduler.h"
+#include "physics/trajectory.h"
+#include "render/frame_snapshot.h"
+
+/*
+Owns the simulation in pipelined mode and steps it on a thread of its own, in real time, independently of the render
+loop. Every completed frame is published as a FrameSnapshot through a triple buffer, so the render thread always draws
+the newest finished state without ever blocking the simulation. Input is forwarded as commands that the simulation
+thread applies at the start of its next frame.
+*/
+class SimulationThread
+{
+public:
+    // A substep count of 0 lets SubstepScheduler choose it every frame, a non-empty record_path streams every stepped
+    // frame to that trajectory file
+    SimulationThread(const sim::Container& container, float frame_time, int substeps, const sim::SleepSettings& sleep,
+                     const std::string& record_path = {});
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void start();
+    void stop();
+
+    // Safe to call from any thread
+    void spawnAt(float x, float y);
+    void clear();
+    void save(const std::string& path);
+    void load(const std::string& path);
+    void resize(sim::ResizeDirection direction);
+    void burst(const sim::Emitter::Settings& emitter, size_t count);
+
+    // Render thread only: the newest snapshot published by the simulation thread
+    const sim::FrameSnapshot& latestSnapshot();
+
+private:
+    struct Command
+    {
+        enum class Type
+        {
+            Spawn,
+            Clear,
+            Save,
+            Load,
+            Resize,
+            Burst
+        };
+
+        Type type;
+        float x{0.0f};
+        float y{0.0f};
+        std::string path;
+        sim::ResizeDirection direction{sim::ResizeDirection::Up};
+        sim::Emitter::Settings emitter{};
+        size_t count{0};
+    };
+
+    void run();
+    void applyCommands();
+    void publishSnapshot();
+
+private:
+    sim::Container container_;
+    sim::ParticleManager manager_;
+
+    const float frame_time_;
+    const int substeps_;
+    sim::SubstepScheduler scheduler_;
+    int last_substeps_{0};
+    uint64_t frame_{0};
+
+    // Physics time and counters of the last frame, closed here rather than at the render thread's pace
+    sim::FrameProfile profile_;
+
+    TripleBuffer<sim::FrameSnapshot> snapshots_;
+    std::unique_ptr<sim::TrajectoryRecorder> recorder_;
+
+    std::mutex commands_mutex_;
+    std::vector<Command> commands_;
+    std::vector<Command> pending_commands_;
+    std::vector<sim::ParticleSpawn> spawn_batch_;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "scenarios.h"
+
+// ----------------------------------------
+// |          allocation counting         |
+// ----------------------------------------
+namespace {
+std::atomic<size_t> allocation_count{0};
+}
+
+void* operator new(size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
+struct Options
+{
+    size_t max_particles = 8'000'000;
+    size_t warmup_steps = 16;
+    size_t steps = 32;
+    size_t threads = 0;
+    uint32_t seed = 1234;
+    size_t sort_every = 0;
+    bool sleep = false;
+    bool sparse_grid = false;
+    bool csv = false;
+    bool scaling = false;
+    sim::SimdLevel simd = sim::detectSimdLevel();
+};
+
+struct PhaseResult
+{
+    const char* name;
+    double seconds = 0.0;
+    size_t allocations = 0;
+};
+
+constexpr float DT = 1.0f / (60.0f * 16.0f);
+
+template <typename Fn>
+void measure(PhaseResult& result, Fn&& fn)
+{
+    using clock = std::chrono::steady_clock;
+    const size_t allocs_before = allocation_count;
+    const auto start = clock::now();
+    fn();
+    result.seconds += std::chrono::duration<double>(clock::now() - start).count();
+    result.allocations += allocation_count - allocs_before;
+}
+
+bool parseArgs(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--csv")
+        {
+            options.csv = true;
+            continue;
+        }
+
+        if (arg == "--scaling")
+        {
+            options.scaling = true;
+            continue;
+        }
+
+        if (arg == "--sleep")
+        {
+            options.sleep = true;
+            continue;
+        }
+
+        if (arg == "--sparse-grid")
+        {
+            options.sparse_grid = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+
+        if (arg == "--simd")
+        {
+            if (!sim::fromString(argv[++i], options.simd) || !sim::isSupported(options.simd))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        const auto value = std::strtoull(argv[++i], nullptr, 10);
+        if      (arg == "--max-particles") { options.max_particles = value; }
+        else if (arg == "--warmup")        { options.warmup_steps = value; }
+        else if (arg == "--steps")         { options.steps = value; }
+        else if (arg == "--threads")       { options.threads = value; }
+        else if (arg == "--seed")          { options.seed = static_cast<uint32_t>(value); }
+        else if (arg == "--sort-every")    { options.sort_every = value; }
+        else                               { return false; }
+    }
+
+    return options.steps > 0;
+}
+
+// Every particle must be bucketed exactly once across all levels and every neighbour id must be a valid index
+bool verifyGrid(const sim::ParticleManager& manager)
+{
+    const size_t count = manager.particle_count();
+    std::vector<bool> seen(count, false);
+    size_t bucketed = 0;
+
+    for (size_t level = 0; level < manager.partitionerLevels(); ++level)
+    {
+        const auto& partitioner = manager.partitioner(level);
+        for (int row = 0; row < partitioner.rows(); ++row)
+        {
+            for (int col = 0; col < partitioner.columns(); ++col)
+            {
+                for (const auto id : partitioner.cellParticles(row, col))
+                {
+                    if (id >= count || seen[id])
+                    {
+                        return false;
+                    }
+
+                    seen[id] = true;
+                    ++bucketed;
+                }
+            }
+        }
+
+        for (const auto id : partitioner.particlesByCell())
+        {
+            bool valid = true;
+            partitioner.forEachNearby(id, [&](sim::Particle::id_type nbr) {
+                valid = valid && nbr < count && nbr != id;
+            });
+
+            if (!valid)
+            {
+                return false;
+            }
+        }
+    }
+
+    return bucketed == count;
+}
+
+bool runScenario(const bench::Scenario& scenario, const Options& options)
+{
+    sim::Container container{scenario.width, scenario.height};
+    container.centerInside({0.0f, static_cast<float>(scenario.width)}, {0.0f, static_cast<float>(scenario.height)});
+    sim::ParticleManager manager{container, options.threads};
+    manager.setSimdLevel(options.simd);
+    manager.setSortInterval(options.sort_every);
+    manager.setGridStorage(options.sparse_grid ? sim::GridStorage::Sparse : sim::GridStorage::Dense);
+
+    sim::SleepSettings sleep;
+    sleep.enabled = options.sleep;
+    manager.setSleepSettings(sleep);
+    bench::populate(scenario, container, manager, options.seed);
+
+    for (size_t i = 0; i < options.warmup_steps; ++i)
+    {
+        manager.updateParticles(DT);
+    }
+
+    PhaseResult grid{"updateGrid"};
+    PhaseResult nearby{"forEachNearby"};
+    PhaseResult collisions{"resolveCollisions"};
+    PhaseResult integrate{"integrate"};
+    PhaseResult total{"updateParticles"};
+
+    size_t neighbour_count = 0;
+    double neighbour_gap = 0.0;
+    for (size_t step = 0; step < options.steps; ++step)
+    {
+        measure(grid, [&] { manager.updateGrid(); });
+
+        // Neighbour queries on their own within each size class, resolveCollisions repeats them internally
+        measure(nearby, [&] {
+            for (size_t id = 0; id < manager.particle_count(); ++id)
+            {
+                // Distance in memory between a particle and its neighbours, a proxy for how many cache lines a pair touches
+                const auto& partitioner = manager.partitioner(manager.partitionerLevel(id));
+                partitioner.forEachNearby(static_cast<sim::Particle::id_type>(id), [&](sim::Particle::id_type nbr) {
+                    ++neighbour_count;
+                    neighbour_gap += static_cast<double>(nbr > id ? nbr - id : id - nbr);
+                });
+            }
+        });
+
+        measure(collisions, [&] { manager.resolveCollisions(); });
+        measure(integrate, [&] { manager.integrate(DT); });
+    }
+
+    for (size_t step = 0; step < options.steps; ++step)
+    {
+        measure(total, [&] { manager.updateParticles(DT); });
+    }
+
+    bool valid = true;
+    if (options.scaling)
+    {
+        manager.updateGrid();
+        valid = verifyGrid(manager);
+        std::printf("%-12s %9zu  grid integrity %s\n", scenario.name.c_str(), scenario.particles, valid ? "ok" : "FAILED");
+    }
+
+    const double particle_steps = static_cast<double>(options.steps) * static_cast<double>(scenario.particles);
+    const std::string size = std::to_string(scenario.width) + "x" + std::to_string(scenario.height);
+
+    for (const auto* result : {&grid, &nearby, &collisions, &integrate, &total})
+    {
+        const double ns = 1e9 * result->seconds / particle_steps;
+        const double allocs = static_cast<double>(result->allocations) / static_cast<double>(options.steps);
+
+        if (options.csv)
+        {
+            std::printf("%s,%zu,%s,%s,%.3f,%.1f\n", scenario.name.c_str(), scenario.particles, size.c_str(), result->name, ns, allocs);
+        }
+        else
+        {
+            std::printf("%-12s %9zu %13s  %-18s %10.3f %14.1f\n", scenario.name.c_str(), scenario.particles, size.c_str(), result->name, ns, allocs);
+        }
+    }
+
+    // Once the grid has been sized a step must not touch the heap at all
+    if (total.allocations > 0)
+    {
+        std::fprintf(stderr, "%s %zu: updateParticles made %zu heap allocations, expected none\n", scenario.name.c_str(), scenario.particles, total.allocations);
+        valid = false;
+    }
+
+    if (!options.csv)
+    {
+        std::printf("%-12s %9s %13s  avg neighbours/particle %.2f, avg neighbour index gap %.0f, asleep %.1f%%, grid levels %zu, grid memory %.2f MiB\n\n", "", "", "",
+                    static_cast<double>(neighbour_count) / particle_steps,
+                    neighbour_count > 0 ? neighbour_gap / static_cast<double>(neighbour_count) : 0.0,
+                    100.0 * static_cast<double>(manager.sleepingCount()) / static_cast<double>(manager.particle_count()),
+                    manager.partitionerLevels(), static_cast<double>(manager.partitionerMemory()) / (1024.0 * 1024.0));
+    }
+
+    return valid;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        std::cerr << "Usage: ParticleSimBench [--max-particles N] [--warmup N] [--steps N] [--threads N] [--seed N] [--sort-every N] [--sleep] [--sparse-grid] [--simd scalar|sse2|avx2|neon] [--csv] [--scaling]\n";
+        return 1;
+    }
+
+    if (options.csv)
+    {
+        std::printf("scenario,particles,container,phase,ns_per_particle_substep,allocs_per_step\n");
+    }
+    else
+    {
+        std::printf("Integration kernel: %s\n\n", sim::toString(options.simd));
+        std::printf("%-12s %9s %13s  %-18s %10s %14s\n", "scenario", "particles", "container", "phase", "ns/p/step", "allocs/step");
+    }
+
+    const auto scenarios = options.scaling ? bench::scalingScenarios(options.max_particles) : bench::defaultScenarios(options.max_particles);
+
+    bool valid = true;
+    for (const auto& scenario : scenarios)
+    {
+        valid = runScenario(scenario, options) && valid;
+        std::fflush(stdout);
+    }
+
+    return valid ? 0 : 1;
+}
\ No newline at end of file
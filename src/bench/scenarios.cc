@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <cstdlib>
+
+#include "scenarios.h"
+
+namespace bench {
+
+namespace {
+
+constexpr float RADIUS = 10.0f;
+constexpr float SPACING = 2.0f * RADIUS;
+
+constexpr float MIXED_MIN_RADIUS = 3.0f;
+constexpr float MIXED_MAX_RADIUS = 30.0f;
+
+constexpr float GRAIN_RADIUS = 4.0f;
+constexpr float BOULDER_RADIUS = 30.0f;
+constexpr float BOULDER_SHARE = 0.05f;
+
+// Fraction of the container area covered by the particles' bounding squares
+constexpr double PILE_FILL = 0.6;
+constexpr double GAS_FILL = 0.05;
+
+// Mean area of a particle's bounding square
+double footprint(Radii radii)
+{
+    if (radii == Radii::Uniform)
+    {
+        return SPACING * SPACING;
+    }
+
+    if (radii == Radii::Bimodal)
+    {
+        return 4.0 * ((1.0 - BOULDER_SHARE) * GRAIN_RADIUS * GRAIN_RADIUS + BOULDER_SHARE * BOULDER_RADIUS * BOULDER_RADIUS);
+    }
+
+    // E[(2r)^2] for r log-uniform on [min, max]
+    const double min = MIXED_MIN_RADIUS;
+    const double max = MIXED_MAX_RADIUS;
+    return 4.0 * (max * max - min * min) / (2.0 * std::log(max / min));
+}
+
+float drawRadius(Radii radii, sim::Random& random)
+{
+    if (radii == Radii::Uniform)
+    {
+        return RADIUS;
+    }
+
+    if (radii == Radii::Bimodal)
+    {
+        return random.uniform(0.0f, 1.0f) < BOULDER_SHARE ? BOULDER_RADIUS : GRAIN_RADIUS;
+    }
+
+    return std::min(MIXED_MAX_RADIUS, std::exp(random.uniform(std::log(MIXED_MIN_RADIUS), std::log(MIXED_MAX_RADIUS))));
+}
+
+Scenario makeScenario(const std::string& name, Layout layout, Radii radii, size_t particles, double fill, double aspect)
+{
+    // Solve width * height = particles * footprint / fill with width = aspect * height
+    const double area = static_cast<double>(particles) * footprint(radii) / fill;
+    const double height = std::sqrt(area / aspect);
+    const double width = height * aspect;
+    const auto margin = static_cast<unsigned int>(2 * SPACING);
+
+    return Scenario{name, layout, radii, particles, static_cast<unsigned int>(std::ceil(width)) + margin, static_cast<unsigned int>(std::ceil(height)) + margin};
+}
+
+}
+
+std::vector<Scenario> defaultScenarios(size_t max_particles)
+{
+    std::vector<Scenario> scenarios;
+
+    for (const size_t count : {1'000u, 10'000u, 100'000u, 1'000'000u})
+    {
+        if (count > max_particles)
+        {
+            continue;
+        }
+
+        scenarios.push_back(makeScenario("pile-square", Layout::Pile, Radii::Uniform, count, PILE_FILL, 1.0));
+        scenarios.push_back(makeScenario("pile-wide", Layout::Pile, Radii::Uniform, count, PILE_FILL, 4.0));
+        scenarios.push_back(makeScenario("gas-square", Layout::Gas, Radii::Uniform, count, GAS_FILL, 1.0));
+        scenarios.push_back(makeScenario("pile-mixed", Layout::Pile, Radii::Mixed, count, PILE_FILL, 1.0));
+        scenarios.push_back(makeScenario("pile-bimodal", Layout::Pile, Radii::Bimodal, count, PILE_FILL, 1.0));
+        scenarios.push_back(makeScenario("gas-mixed", Layout::Gas, Radii::Mixed, count, GAS_FILL, 1.0));
+    }
+
+    return scenarios;
+}
+
+std::vector<Scenario> scalingScenarios(size_t max_particles)
+{
+    std::vector<Scenario> scenarios;
+
+    for (const size_t count : {65'537u, 1'000'000u, 2'000'000u, 4'000'000u, 8'000'000u})
+    {
+        if (count <= max_particles)
+        {
+            scenarios.push_back(makeScenario("scaling", Layout::Pile, Radii::Uniform, count, PILE_FILL, 1.0));
+        }
+    }
+
+    return scenarios;
+}
+
+void populate(const Scenario& scenario, sim::Container& container, sim::ParticleManager& manager, uint32_t seed)
+{
+    manager.setSeed(seed);
+    auto& random = manager.random();
+
+    // Built up in full and handed over in one batch
+    std::vector<sim::ParticleSpawn> batch;
+    batch.reserve(scenario.particles);
+
+    const auto& [x_bounds, y_bounds] = container.getBounds(RADIUS);
+    const auto& [x_min, x_max] = x_bounds;
+    const auto& [y_min, y_max] = y_bounds;
+
+    if (scenario.layout == Layout::Pile && scenario.radii != Radii::Uniform)
+    {
+        // Rows of touching particles from the floor up, sorted into layers from the biggest particles at the bottom to
+        // the smallest on top, roughly how a shaken pile settles and dense enough that every row is mostly filled
+        std::vector<float> radii(scenario.particles);
+        for (auto& radius : radii)
+        {
+            radius = drawRadius(scenario.radii, random);
+        }
+        std::sort(radii.begin(), radii.end(), std::greater<>{});
+
+        const auto& [walls_x, walls_y] = container.getBounds();
+        float x = walls_x[0];
+        float floor = walls_y[1];
+        float row_height = 0.0f;
+        for (const float radius : radii)
+        {
+            if (x + 2.0f * radius > walls_x[1])
+            {
+                x = walls_x[0];
+                floor -= row_height;
+                row_height = 0.0f;
+            }
+
+            batch.push_back(sim::ParticleSpawn{sim::Vec2f{x + radius, floor - radius}, sim::Vec2f{0.0f, 0.0f}, radius});
+            x += 2.0f * radius;
+            row_height = std::max(row_height, 2.0f * radius);
+        }
+        manager.spawn(batch);
+        return;
+    }
+
+    if (scenario.layout == Layout::Pile)
+    {
+        // Rows of touching particles stacked up from the floor, every other row shifted so they do not stand in perfect columns
+        const auto columns = static_cast<size_t>((x_max - x_min) / SPACING);
+        for (size_t i = 0; i < scenario.particles; ++i)
+        {
+            const size_t row = i / columns;
+            const float shift = (row % 2 == 0) ? 0.0f : 0.5f * RADIUS;
+            const float x = x_min + shift + SPACING * static_cast<float>(i % columns);
+            const float y = y_max - SPACING * static_cast<float>(row);
+            batch.push_back(sim::ParticleSpawn{sim::Vec2f{x, y}, sim::Vec2f{0.0f, 0.0f}, RADIUS});
+        }
+        manager.spawn(batch);
+        return;
+    }
+
+    const float v_max = 0.3f * sim::MAX_VEL;
+    for (size_t i = 0; i < scenario.particles; ++i)
+    {
+        const float radius = drawRadius(scenario.radii, random);
+        const float x = random.uniform(x_min, x_max);
+        const float y = random.uniform(y_min, y_max);
+        const float vx = random.uniform(-v_max, v_max);
+        const float vy = random.uniform(-v_max, v_max);
+        batch.push_back(sim::ParticleSpawn{sim::Vec2f{x, y}, sim::Vec2f{vx, vy}, radius});
+    }
+    manager.spawn(batch);
+}
+
+}
\ No newline at end of file
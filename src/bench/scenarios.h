@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "physics/particle_manager.h"
+
+namespace bench {
+
+enum class Layout
+{
+    Pile,   // particles packed in touching rows at the bottom of the container
+    Gas     // particles scattered over the whole container with random velocities
+};
+
+enum class Radii
+{
+    Uniform,    // every particle has radius 10
+    Mixed,      // log-uniform between 3 and 30, as many particles between 3 and 10 as between 10 and 30
+    Bimodal     // mostly grains of radius 4 with one in twenty a boulder of radius 30
+};
+
+struct Scenario
+{
+    std::string name;
+    Layout layout;
+    Radii radii;
+    size_t particles;
+    unsigned int width;
+    unsigned int height;
+};
+
+// Every layout, radius mix and container shape at 1k, 10k, 100k and 1M particles, skipping counts above max_particles
+std::vector<Scenario> defaultScenarios(size_t max_particles);
+
+// Dense piles from just past the 16-bit index limit up to several million particles, used to check index integrity
+std::vector<Scenario> scalingScenarios(size_t max_particles);
+
+// Fills an empty manager according to the scenario, the same seed always gives the same starting state
+void populate(const Scenario& scenario, sim::Container& container, sim::ParticleManager& manager, uint32_t seed);
+
+}
\ No newline at end of file
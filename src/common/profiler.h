@@ -0,0 +1,242 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+
+namespace sim {
+
+// Whether the PARTICLESIM_PROFILE_* macros at the bottom record anything in this build
+#if PARTICLESIM_PROFILING
+inline constexpr bool PROFILING_ENABLED = true;
+#else
+inline constexpr bool PROFILING_ENABLED = false;
+#endif
+
+// Phases of a frame that the profiler times. Physics zones add up the time of every thread working on them, so with
+// several threads they can exceed the step's wall time; Step, Draw and Present are wall time on the calling thread.
+enum class ProfileZone : uint8_t
+{
+    Step,
+    GridRebuild,
+    Collisions,
+    Integration,
+    Draw,
+    Present,
+    Count
+};
+
+// Work done in a frame. A neighbour query is one gathered cell neighbourhood or one forEachNearby() call, a tested
+// pair one distance check and a resolved pair one that actually overlapped.
+enum class ProfileCounter : uint8_t
+{
+    NeighbourQueries,
+    PairsTested,
+    PairsResolved,
+    Count
+};
+
+inline constexpr size_t PROFILE_ZONES = static_cast<size_t>(ProfileZone::Count);
+inline constexpr size_t PROFILE_COUNTERS = static_cast<size_t>(ProfileCounter::Count);
+
+// Zones recorded while stepping the simulation and while showing it. The counters all belong to the simulation.
+inline constexpr std::array<ProfileZone, 4> PHYSICS_ZONES{ProfileZone::Step, ProfileZone::GridRebuild,
+                                                          ProfileZone::Collisions, ProfileZone::Integration};
+inline constexpr std::array<ProfileZone, 2> RENDER_ZONES{ProfileZone::Draw, ProfileZone::Present};
+
+inline const char* toString(ProfileZone zone)
+{
+    constexpr std::array<const char*, PROFILE_ZONES> names{"step", "grid", "collisions", "integration", "draw", "present"};
+    return names[static_cast<size_t>(zone)];
+}
+
+inline const char* toString(ProfileCounter counter)
+{
+    constexpr std::array<const char*, PROFILE_COUNTERS> names{"neighbour_queries", "pairs_tested", "pairs_resolved"};
+    return names[static_cast<size_t>(counter)];
+}
+
+// Everything recorded between two Profiler::endFrame() calls
+struct FrameProfile
+{
+    uint64_t frame{0};
+    uint64_t frame_ns{0};
+    std::array<uint64_t, PROFILE_ZONES> zone_ns{};
+    std::array<uint64_t, PROFILE_COUNTERS> counts{};
+
+    double milliseconds(ProfileZone zone) const
+    {
+        return static_cast<double>(zone_ns[static_cast<size_t>(zone)]) * 1e-6;
+    }
+
+    uint64_t count(ProfileCounter counter) const
+    {
+        return counts[static_cast<size_t>(counter)];
+    }
+};
+
+/*
+Process-wide totals of the PARTICLESIM_PROFILE_* macros, collected once per frame. Every thread adds to a shard of its
+own, a cache line apart from the others, so that worker threads counting pairs do not fight over a shared counter.
+Recording never allocates or locks.
+
+The macros only do something in builds configured with -DPARTICLESIM_PROFILING=ON. Otherwise they compile to nothing
+and every frame profile stays zero.
+*/
+class Profiler
+{
+public:
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void addTime(ProfileZone zone, uint64_t ns)
+    {
+        shard().zone_ns[static_cast<size_t>(zone)].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void count(ProfileCounter counter, uint64_t amount)
+    {
+        shard().counts[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // Totals since the last call, which also starts the next frame. Meant to be called by one thread, once per frame.
+    FrameProfile endFrame()
+    {
+        return endFrame(ALL_ZONES, true);
+    }
+
+    // Same, but only collects the given zones, and the counters if counters is set, leaving the rest to take()
+    FrameProfile endFrame(std::span<const ProfileZone> zones, bool counters)
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        FrameProfile profile = take(zones, counters);
+        profile.frame = frame_++;
+        profile.frame_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame_start_).count());
+        frame_start_ = now;
+        return profile;
+    }
+
+    // Totals of the given zones, and of the counters if counters is set, since they were last collected. Does not
+    // start a new frame, so frame and frame_ns stay 0. Lets a thread running at its own rate, like the simulation
+    // thread of the pipelined app, close frames of its own without mixing in another thread's.
+    FrameProfile take(std::span<const ProfileZone> zones, bool counters)
+    {
+        FrameProfile profile;
+        for (auto& shard : shards_)
+        {
+            for (const auto zone : zones)
+            {
+                const size_t i = static_cast<size_t>(zone);
+                profile.zone_ns[i] += shard.zone_ns[i].exchange(0, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; counters && i < PROFILE_COUNTERS; ++i)
+            {
+                profile.counts[i] += shard.counts[i].exchange(0, std::memory_order_relaxed);
+            }
+        }
+
+        return profile;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, PROFILE_ZONES> zone_ns{};
+        std::array<std::atomic<uint64_t>, PROFILE_COUNTERS> counts{};
+    };
+
+    Shard& shard()
+    {
+        // More threads than shards just share, the totals stay right
+        thread_local const size_t index = next_shard_.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return shards_[index];
+    }
+
+    static constexpr size_t SHARDS = 64;
+
+    static constexpr auto ALL_ZONES = [] {
+        std::array<ProfileZone, PROFILE_ZONES> zones{};
+        for (size_t i = 0; i < PROFILE_ZONES; ++i)
+        {
+            zones[i] = static_cast<ProfileZone>(i);
+        }
+        return zones;
+    }();
+
+    std::array<Shard, SHARDS> shards_{};
+    std::atomic<size_t> next_shard_{0};
+    uint64_t frame_{0};
+    std::chrono::steady_clock::time_point frame_start_{std::chrono::steady_clock::now()};
+};
+
+// Adds the time from construction to destruction to a zone
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(ProfileZone zone)
+        : zone_{zone}
+        , start_{std::chrono::steady_clock::now()}
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        Profiler::instance().addTime(zone_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    ProfileZone zone_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// One CSV line per frame, with times in milliseconds, for the profile dumps of the app and the headless runner
+inline void writeProfileHeader(std::ostream& out)
+{
+    out << "frame,particles,frame_ms";
+    for (size_t i = 0; i < PROFILE_ZONES; ++i)
+    {
+        out << ',' << toString(static_cast<ProfileZone>(i)) << "_ms";
+    }
+    for (size_t i = 0; i < PROFILE_COUNTERS; ++i)
+    {
+        out << ',' << toString(static_cast<ProfileCounter>(i));
+    }
+    out << '\n';
+}
+
+inline void writeProfileRow(std::ostream& out, const FrameProfile& profile, size_t particles)
+{
+    out << profile.frame << ',' << particles << ',' << static_cast<double>(profile.frame_ns) * 1e-6;
+    for (size_t i = 0; i < PROFILE_ZONES; ++i)
+    {
+        out << ',' << profile.milliseconds(static_cast<ProfileZone>(i));
+    }
+    for (size_t i = 0; i < PROFILE_COUNTERS; ++i)
+    {
+        out << ',' << profile.counts[i];
+    }
+    out << '\n';
+}
+
+}
+
+#if PARTICLESIM_PROFILING
+    #define PARTICLESIM_PROFILE_CONCAT_INNER(a, b) a##b
+    #define PARTICLESIM_PROFILE_CONCAT(a, b) PARTICLESIM_PROFILE_CONCAT_INNER(a, b)
+    #define PARTICLESIM_PROFILE_SCOPE(zone) const ::sim::ScopedTimer PARTICLESIM_PROFILE_CONCAT(profile_scope_, __LINE__){zone}
+    #define PARTICLESIM_PROFILE_COUNT(counter, amount) ::sim::Profiler::instance().count(counter, amount)
+#else
+    #define PARTICLESIM_PROFILE_SCOPE(zone) static_cast<void>(0)
+    #define PARTICLESIM_PROFILE_COUNT(counter, amount) static_cast<void>(0)
+#endif
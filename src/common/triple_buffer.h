@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+Lock-free handoff of whole values from one producer thread to one consumer thread. The producer always has a slot of its
+own to write into, the consumer always has a slot of its own to read from, and the third slot holds the most recent
+published value. Neither side ever waits for the other; a consumer that falls behind simply skips to the newest value.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side: the slot to fill in before calling publish()
+    T& writeBuffer()
+    {
+        return slots_[write_];
+    }
+
+    // Producer side: makes the write buffer the newest value and takes over the slot it replaces
+    void publish()
+    {
+        write_ = shared_.exchange(static_cast<uint8_t>(write_ | DIRTY), std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer side: switches to the newest published value, returns false if nothing new was published
+    bool update()
+    {
+        if ((shared_.load(std::memory_order_acquire) & DIRTY) == 0)
+        {
+            return false;
+        }
+
+        read_ = shared_.exchange(read_, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // Consumer side: the value selected by the last successful update()
+    const T& readBuffer() const
+    {
+        return slots_[read_];
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t DIRTY = 0x4;
+
+    std::array<T, 3> slots_{};
+    uint8_t write_{0};
+    uint8_t read_{1};
+    std::atomic<uint8_t> shared_{2};
+};
\ No newline at end of file
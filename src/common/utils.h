@@ -1,11 +1,47 @@
 #pragma once
+#include <cstdint>
 #include <random>
 
-inline float generateRandomFloat(float min, float max)
+namespace sim {
+
+/*
+The random number source of one simulation. Two engines built from the same seed produce the same numbers on every
+platform: std::mt19937 is fully specified by the standard, and uniform() maps its output to floats itself because
+std::uniform_real_distribution is free to differ between standard libraries.
+*/
+class Random
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+public:
+    static constexpr uint32_t DEFAULT_SEED = 5489u;
+
+    explicit Random(uint32_t seed = DEFAULT_SEED)
+        : engine_{seed}
+        , seed_{seed}
+    {
+    }
+
+    // Restarts the sequence, the same seed always gives the same numbers again
+    void reseed(uint32_t seed)
+    {
+        engine_.seed(seed);
+        seed_ = seed;
+    }
+
+    uint32_t seed() const
+    {
+        return seed_;
+    }
+
+    // Uniform in [min, max], built from the top 24 bits so every value is exactly representable
+    float uniform(float min, float max)
+    {
+        const float unit = static_cast<float>(engine_() >> 8) * 0x1p-24f;
+        return min + (max - min) * unit;
+    }
+
+private:
+    std::mt19937 engine_;
+    uint32_t seed_;
+};
 
-    std::uniform_real_distribution<float> dis(min, max);
-    return dis(gen);
-}
\ No newline at end of file
+}
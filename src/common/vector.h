@@ -1,21 +1,21 @@
 #pragma once
 #include <algorithm>
-#include <SFML/System/Vector2.hpp>
 #include <cmath>
+#include <stdexcept>
+#include <utility>
 
 namespace sim {
 
-// A wrapper around the sf::Vector2<T> classes to support addition/subtraction between vectors as well as scalar multiplication
+// A small 2D vector supporting addition/subtraction between vectors as well as scalar multiplication and division
 template <typename T>
-class Vec2d : public sf::Vector2<T>
+class Vec2d
 {
 public:
     // Constructors
-    Vec2d(T x_val = 0, T y_val = 0) : sf::Vector2<T>(x_val, y_val) {}
-    Vec2d(const sf::Vector2<T>& v) : sf::Vector2<T>(v) {}
+    Vec2d(T x_val = 0, T y_val = 0) : x(x_val), y(y_val) {}
 
     template <typename OtherT>
-    static Vec2d<T> from(const sf::Vector2<OtherT>& v)
+    static Vec2d<T> from(const Vec2d<OtherT>& v)
     {
         T x = static_cast<T>(v.x);
         T y = static_cast<T>(v.y);
@@ -25,13 +25,13 @@ public:
     using MinMaxLimits = std::pair<T, T>;
 
     // Addition
-    Vec2d operator+(const sf::Vector2<T>& other) const
+    Vec2d operator+(const Vec2d& other) const
     {
         return Vec2d(this->x + other.x, this->y + other.y);
     }
 
     // Subtraction
-    Vec2d operator-(const sf::Vector2<T>& other) const
+    Vec2d operator-(const Vec2d& other) const
     {
         return Vec2d(this->x - other.x, this->y - other.y);
     }
@@ -47,14 +47,20 @@ public:
         return Vec2d(this->x * multiplier, this->y * multiplier);
     }
 
-    Vec2d& operator+=(const sf::Vector2<T>& other)
+    // Scalar Division
+    Vec2d operator/(T divisor) const
+    {
+        return Vec2d(this->x / divisor, this->y / divisor);
+    }
+
+    Vec2d& operator+=(const Vec2d& other)
     {
         this->x += other.x;
         this->y += other.y;
         return *this;
     }
 
-    Vec2d& operator-=(const sf::Vector2<T>& other)
+    Vec2d& operator-=(const Vec2d& other)
     {
         this->x -= other.x;
         this->y -= other.y;
@@ -68,6 +74,11 @@ public:
         return *this;
     }
 
+    bool operator==(const Vec2d& other) const
+    {
+        return this->x == other.x && this->y == other.y;
+    }
+
     T& operator[](int axis)
     {
         if (axis != 0 && axis != 1)
@@ -148,13 +159,20 @@ public:
         return std::sqrt(this->x * this->x + this->y * this->y);
     }
 
-private:
+    T x;
+    T y;
 };
 
 using Vec2f = Vec2d<float>;
 using Vec2i = Vec2d<int>;
 using Vec2u = Vec2d<unsigned int>;
 
+template <typename T>
+Vec2d<T> operator*(T multiplier, const Vec2d<T>& vec)
+{
+    return vec * multiplier;
+}
+
 template <typename T>
 T vec_dot(Vec2d<T> first, Vec2d<T> second)
 {
@@ -171,7 +189,7 @@ void assign_piecewise(Vec2d<T> vec, T& first, T& second)
 template <typename T>
 Vec2d<T> midpoint(Vec2d<T> first, Vec2d<T> second)
 {
-    return ( first + second ) / 2.0f;
+    return ( first + second ) / static_cast<T>(2);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/profiler.h"
+#include "physics/particle_manager.h"
+#include "physics/snapshot.h"
+#include "physics/substep_scheduler.h"
+#include "physics/trajectory.h"
+
+#include "headless_app.h"
+
+namespace {
+
+bool parseCount(const char* text, size_t& value)
+{
+    try
+    {
+        size_t consumed = 0;
+        const auto parsed = std::stoull(text, &consumed);
+        if (text[consumed] != '\0')
+        {
+            return false;
+        }
+
+        value = static_cast<size_t>(parsed);
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+}
+
+bool ParticleSimHeadless::parseArgs(int argc, char** argv, Config& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h")
+        {
+            return false;
+        }
+
+        if (arg == "--adaptive")
+        {
+            config.adaptive = true;
+            continue;
+        }
+
+        if (arg == "--sleep")
+        {
+            config.sleep = true;
+            continue;
+        }
+
+        if (arg == "--sparse-grid")
+        {
+            config.sparse_grid = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+
+        if (arg == "--load")
+        {
+            config.load_path = argv[++i];
+            continue;
+        }
+
+        if (arg == "--save")
+        {
+            config.save_path = argv[++i];
+            continue;
+        }
+
+        if (arg == "--record")
+        {
+            config.record_path = argv[++i];
+            continue;
+        }
+
+        if (arg == "--profile")
+        {
+            if (!sim::PROFILING_ENABLED)
+            {
+                std::cerr << "--profile needs a build configured with -DPARTICLESIM_PROFILING=ON\n";
+                return false;
+            }
+
+            config.profile_path = argv[++i];
+            continue;
+        }
+
+        if (arg == "--expect-hash")
+        {
+            try
+            {
+                size_t consumed = 0;
+                config.expected_hash = std::stoull(argv[++i], &consumed, 16);
+                if (argv[i][consumed] == '\0')
+                {
+                    continue;
+                }
+            }
+            catch (const std::exception&)
+            {
+            }
+
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << "\n";
+            return false;
+        }
+
+        size_t value = 0;
+        if (!parseCount(argv[++i], value))
+        {
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << "\n";
+            return false;
+        }
+
+        if      (arg == "--particles")    { config.particles = value; }
+        else if (arg == "--frames")       { config.frames = value; }
+        else if (arg == "--substeps")     { config.substeps = static_cast<int>(value); }
+        else if (arg == "--min-substeps") { config.min_substeps = static_cast<int>(value); }
+        else if (arg == "--max-substeps") { config.max_substeps = static_cast<int>(value); }
+        else if (arg == "--threads")      { config.threads = value; }
+        else if (arg == "--width")        { config.width = static_cast<unsigned int>(value); }
+        else if (arg == "--height")       { config.height = static_cast<unsigned int>(value); }
+        else if (arg == "--report-every") { config.report_every = value; }
+        else if (arg == "--seed")         { config.seed = static_cast<uint32_t>(value); }
+        else if (arg == "--sort-every")   { config.sort_every = value; }
+        else if (arg == "--resize-every") { config.resize_every = value; }
+        else
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+
+    return config.substeps > 0 && config.min_substeps > 0 && config.max_substeps >= config.min_substeps;
+}
+
+void ParticleSimHeadless::printUsage(std::ostream& out)
+{
+    out << "Usage: ParticleSimHeadless [options]\n"
+        << "  --particles N      number of particles to simulate (default 10000)\n"
+        << "  --frames N         number of frames to step (default 600)\n"
+        << "  --substeps N       substeps per frame (default 16)\n"
+        << "  --adaptive         choose the substeps of every frame from speed and overlap instead\n"
+        << "  --min-substeps N   lower bound for --adaptive (default 1)\n"
+        << "  --max-substeps N   upper bound for --adaptive (default 32)\n"
+        << "  --threads N        worker threads, 0 for one per core (default 0)\n"
+        << "  --width N          container width, 0 to size from the particle count (default 0)\n"
+        << "  --height N         container height, 0 to size from the particle count (default 0)\n"
+        << "  --report-every N   print progress every N frames, 0 to disable (default 0)\n"
+        << "  --load PATH        restore particles, container and step count from a snapshot\n"
+        << "  --save PATH        write a snapshot after the last frame\n"
+        << "  --record PATH      write every frame to a trajectory file for replay\n"
+        << "  --profile PATH     write per-frame phase timings and counters as CSV (profiling builds only)\n"
+        << "  --sort-every N     reorder particles into grid cell order every N substeps, 0 to disable (default 0)\n"
+        << "  --resize-every N   grow the container by one step every N frames, then shrink it back, 0 to disable (default 0)\n"
+        << "  --sleep            put particles that have come to rest to sleep until something disturbs them\n"
+        << "  --sparse-grid      store only occupied grid cells, for large and mostly empty containers\n"
+        << "  --seed N           seed for the lattice jitter (default " << sim::Random::DEFAULT_SEED << ")\n"
+        << "  --expect-hash HEX  exit with status 2 unless the final state hash matches\n";
+}
+
+std::string ParticleSimHeadless::formatHash(uint64_t hash)
+{
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+ParticleSimHeadless::ParticleSimHeadless(const Config& config)
+    : config_{config}
+{
+}
+
+bool ParticleSimHeadless::spawnLattice(sim::ParticleManager& manager, const sim::Container& container) const
+{
+    const float spacing = 2.0f * PARTICLE_RADIUS + 1.0f;
+
+    const auto& [x_bounds, y_bounds] = container.getBounds(PARTICLE_RADIUS);
+    const auto& [x_min, x_max] = x_bounds;
+    const auto& [y_min, y_max] = y_bounds;
+    const auto columns = static_cast<size_t>((x_max - x_min) / spacing) + 1;
+    const auto rows = static_cast<size_t>((y_max - y_min) / spacing) + 1;
+
+    if (columns * rows < config_.particles)
+    {
+        std::cerr << "A " << container.getWidth() << "x" << container.getHeight() << " container fits at most " << columns * rows << " particles\n";
+        return false;
+    }
+
+    // Jitter of up to half the gap between neighbours, so the pile does not settle into perfect columns
+    auto& random = manager.random();
+    std::vector<sim::ParticleSpawn> lattice(config_.particles);
+    for (size_t i = 0; i < config_.particles; ++i)
+    {
+        const float x = x_min + spacing * static_cast<float>(i % columns) + random.uniform(-0.5f, 0.5f);
+        const float y = y_min + spacing * static_cast<float>(i / columns) + random.uniform(-0.5f, 0.5f);
+        lattice[i] = sim::ParticleSpawn{sim::Vec2f{x, y}, sim::Vec2f{0.0f, 0.0f}, PARTICLE_RADIUS};
+    }
+
+    manager.spawn(lattice);
+    return true;
+}
+
+int ParticleSimHeadless::Run()
+{
+    const float spacing = 2.0f * PARTICLE_RADIUS + 1.0f;
+
+    // Without explicit dimensions use a square container that the lattice fills about halfway
+    const auto side = static_cast<unsigned int>(std::ceil(std::sqrt(2.0 * config_.particles) * spacing)) + 4 * static_cast<unsigned int>(spacing);
+    const unsigned int width = config_.width > 0 ? config_.width : side;
+    const unsigned int height = config_.height > 0 ? config_.height : side;
+
+    sim::Container container{width, height};
+    container.centerInside({0.0f, static_cast<float>(width)}, {0.0f, static_cast<float>(height)});
+    sim::ParticleManager manager{container, config_.threads};
+    manager.setSeed(config_.seed);
+    manager.setSortInterval(config_.sort_every);
+    manager.setGridStorage(config_.sparse_grid ? sim::GridStorage::Sparse : sim::GridStorage::Dense);
+
+    sim::SleepSettings sleep;
+    sleep.enabled = config_.sleep;
+    manager.setSleepSettings(sleep);
+
+    if (!config_.load_path.empty())
+    {
+        try
+        {
+            sim::loadSnapshot(config_.load_path, manager);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not load snapshot: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    else if (!spawnLattice(manager, container))
+    {
+        return 1;
+    }
+
+    std::unique_ptr<sim::TrajectoryRecorder> recorder;
+    if (!config_.record_path.empty())
+    {
+        try
+        {
+            recorder = std::make_unique<sim::TrajectoryRecorder>(config_.record_path);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not start recording: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    std::ofstream profile_out;
+    if (!config_.profile_path.empty())
+    {
+        profile_out.open(config_.profile_path);
+        if (!profile_out)
+        {
+            std::cerr << "Could not open " << config_.profile_path << " for the profile\n";
+            return 1;
+        }
+        sim::writeProfileHeader(profile_out);
+    }
+
+    sim::SubstepScheduler::Settings settings;
+    settings.min_substeps = config_.min_substeps;
+    settings.max_substeps = config_.max_substeps;
+    sim::SubstepScheduler scheduler{settings};
+
+    size_t total_substeps = 0;
+    int fewest_substeps = config_.adaptive ? config_.max_substeps : config_.substeps;
+    int most_substeps = config_.adaptive ? config_.min_substeps : config_.substeps;
+
+    // Setup is not part of the first frame
+    sim::FrameProfile profile_total;
+    sim::Profiler::instance().endFrame();
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    for (size_t frame = 1; frame <= config_.frames; ++frame)
+    {
+        // Alternately one step wider and taller and one step back, the manager refits its grids on the next step
+        if (config_.resize_every > 0 && frame % config_.resize_every == 0)
+        {
+            const bool grow = (frame / config_.resize_every) % 2 == 1;
+            container.handleResize(grow ? sim::ResizeDirection::Up : sim::ResizeDirection::Down);
+            container.handleResize(grow ? sim::ResizeDirection::Right : sim::ResizeDirection::Left);
+        }
+
+        const int substeps = config_.adaptive ? scheduler.next(manager, TIMESTEP) : config_.substeps;
+        const float dt = TIMESTEP / static_cast<float>(substeps);
+        for (int i = substeps; i > 0; i--)
+        {
+            manager.updateParticles(dt);
+        }
+
+        total_substeps += static_cast<size_t>(substeps);
+        fewest_substeps = std::min(fewest_substeps, substeps);
+        most_substeps = std::max(most_substeps, substeps);
+
+        if (recorder)
+        {
+            recorder->record(manager.particles(), manager.container(), manager.stepCount());
+        }
+
+        if (sim::PROFILING_ENABLED)
+        {
+            const auto profile = sim::Profiler::instance().endFrame();
+            for (size_t i = 0; i < sim::PROFILE_ZONES; ++i)
+            {
+                profile_total.zone_ns[i] += profile.zone_ns[i];
+            }
+            for (size_t i = 0; i < sim::PROFILE_COUNTERS; ++i)
+            {
+                profile_total.counts[i] += profile.counts[i];
+            }
+
+            if (profile_out)
+            {
+                sim::writeProfileRow(profile_out, profile, manager.particle_count());
+            }
+        }
+
+        if (config_.report_every > 0 && frame % config_.report_every == 0)
+        {
+            const std::chrono::duration<double> elapsed = clock::now() - start;
+            std::cout << "frame " << frame << " | " << elapsed.count() << " s | substeps " << substeps << " | Avg Speed: " << manager.statistics().meanSpeed() << "\n";
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = clock::now() - start;
+
+    if (recorder)
+    {
+        try
+        {
+            recorder->finish();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not finish recording: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (!config_.save_path.empty())
+    {
+        try
+        {
+            sim::saveSnapshot(config_.save_path, manager);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not save snapshot: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    const double particle_steps = static_cast<double>(total_substeps) * static_cast<double>(manager.particle_count());
+    const double avg_substeps = config_.frames > 0 ? static_cast<double>(total_substeps) / static_cast<double>(config_.frames) : 0.0;
+    const auto& stats = manager.statistics();
+
+    std::cout << "Particles: " << manager.particle_count()
+              << " | Step: " << manager.stepCount()
+              << " | Threads: " << (config_.threads > 0 ? config_.threads : std::max(1u, std::thread::hardware_concurrency()))
+              << " | SIMD: " << sim::toString(manager.simdLevel())
+              << " | Container: " << manager.container().getWidth() << "x" << manager.container().getHeight()
+              << " | Frames: " << config_.frames << " x " << avg_substeps << " substeps";
+
+    if (config_.adaptive)
+    {
+        std::cout << " (adaptive, " << fewest_substeps << " to " << most_substeps << ")";
+    }
+
+    std::cout << "\n"
+              << "Wall time: " << elapsed.count() << " s"
+              << " | " << (config_.frames > 0 ? 1000.0 * elapsed.count() / static_cast<double>(config_.frames) : 0.0) << " ms/frame"
+              << " | " << (particle_steps > 0.0 ? 1e9 * elapsed.count() / particle_steps : 0.0) << " ns/particle/substep\n"
+              << "Avg Speed: " << stats.meanSpeed() << " | Max overlap: " << 100.0f * manager.maxOverlap() << "%"
+              << " | Grid: " << (config_.sparse_grid ? "sparse" : "dense") << ", " << static_cast<double>(manager.partitionerMemory()) / (1024.0 * 1024.0) << " MiB";
+
+    if (config_.sleep)
+    {
+        const size_t count = manager.particle_count();
+        std::cout << " | Asleep: " << manager.sleepingCount()
+                  << " (" << (count > 0 ? 100.0 * static_cast<double>(manager.sleepingCount()) / static_cast<double>(count) : 0.0) << "%)";
+    }
+
+    std::cout << "\n";
+
+    std::cout << "Max Speed: " << stats.max_speed << " | Kinetic energy: " << stats.kinetic_energy
+              << " | Momentum: (" << stats.momentum.x << ", " << stats.momentum.y << ")"
+              << " | Bounds: (" << stats.bounds_min.x << ", " << stats.bounds_min.y << ") to (" << stats.bounds_max.x << ", " << stats.bounds_max.y << ")\n";
+
+    // Physics zones add up the time of every thread, see ProfileZone
+    if (sim::PROFILING_ENABLED && config_.frames > 0)
+    {
+        const double frames = static_cast<double>(config_.frames);
+        std::cout << "Profile per frame:";
+        for (const auto zone : {sim::ProfileZone::Step, sim::ProfileZone::GridRebuild, sim::ProfileZone::Collisions, sim::ProfileZone::Integration})
+        {
+            std::cout << " " << sim::toString(zone) << " " << profile_total.milliseconds(zone) / frames << " ms |";
+        }
+        for (size_t i = 0; i < sim::PROFILE_COUNTERS; ++i)
+        {
+            std::cout << (i > 0 ? " | " : " ") << sim::toString(static_cast<sim::ProfileCounter>(i)) << " " << static_cast<double>(profile_total.counts[i]) / frames;
+        }
+        std::cout << "\n";
+    }
+
+    const uint64_t hash = manager.stateHash();
+    std::cout << "State hash: " << formatHash(hash) << "\n";
+
+    if (config_.expected_hash && *config_.expected_hash != hash)
+    {
+        std::cerr << "State hash mismatch, expected " << formatHash(*config_.expected_hash) << "\n";
+        return 2;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#include "common/utils.h"
+
+namespace sim {
+class Container;
+class ParticleManager;
+}
+
+/*
+Runs the simulation without a window. Particles are laid out on a seeded, slightly jittered lattice at the top of the
+container, or restored from a snapshot, and stepped for a fixed number of frames as fast as the CPU allows, then timing
+figures and a hash of the final state are printed. Runs with the same options produce the same hash.
+*/
+class ParticleSimHeadless
+{
+public:
+    struct Config
+    {
+        size_t particles = 10000;
+        size_t frames = 600;
+        int substeps = 16;
+        bool adaptive = false;      // let SubstepScheduler pick the substeps of every frame instead
+        int min_substeps = 1;
+        int max_substeps = 32;
+        size_t threads = 0;         // 0 uses one thread per hardware core
+        unsigned int width = 0;     // 0 sizes the container from the particle count
+        unsigned int height = 0;
+        size_t report_every = 0;    // 0 only prints the final summary
+        std::string load_path;      // start from this snapshot instead of a fresh lattice
+        std::string save_path;      // write a snapshot here once all frames have run
+        std::string record_path;    // stream every frame to this trajectory file
+        std::string profile_path;   // write per-frame timers and counters here as CSV, profiling builds only
+        size_t sort_every = 0;      // 0 never reorders the particle store
+        size_t resize_every = 0;    // 0 never resizes the container
+        bool sleep = false;         // put particles that have come to rest to sleep
+        bool sparse_grid = false;   // store only the occupied grid cells
+        uint32_t seed = sim::Random::DEFAULT_SEED;
+        std::optional<uint64_t> expected_hash;  // fail the run unless the final state hashes to this
+    };
+
+    static bool parseArgs(int argc, char** argv, Config& config);
+    static void printUsage(std::ostream& out);
+
+    explicit ParticleSimHeadless(const Config& config);
+
+    int Run();
+
+private:
+    bool spawnLattice(sim::ParticleManager& manager, const sim::Container& container) const;
+    static std::string formatHash(uint64_t hash);
+
+    Config config_;
+
+    static constexpr float TIMESTEP = 1.0f / 60.0f;
+    static constexpr float PARTICLE_RADIUS = 10.0f;
+};
\ No newline at end of file
@@ -0,0 +1,16 @@
+#include <iostream>
+
+#include "headless_app.h"
+
+int main(int argc, char** argv)
+{
+    ParticleSimHeadless::Config config;
+    if (!ParticleSimHeadless::parseArgs(argc, argv, config))
+    {
+        ParticleSimHeadless::printUsage(std::cerr);
+        return 1;
+    }
+
+    ParticleSimHeadless app{config};
+    return app.Run();
+}
\ No newline at end of file
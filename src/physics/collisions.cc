@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+
+#include "common/constants.h"
+#include "common/profiler.h"
+
+#include "collisions.h"
+
+namespace sim {
+
+namespace {
+
+// Same rules as Particle::changeVelocity: changes below 0.1% of the current speed on an axis are dropped
+void changeVelocity(float& vx, float& vy, float dx, float dy)
+{
+    if (std::abs(dx) / std::abs(vx) < 0.001f)
+    {
+        dx = 0.0f;
+    }
+
+    if (std::abs(dy) / std::abs(vy) < 0.001f)
+    {
+        dy = 0.0f;
+    }
+
+    vx = std::clamp(vx + dx, -MAX_VEL, MAX_VEL);
+    vy = std::clamp(vy + dy, -MAX_VEL, MAX_VEL);
+}
+
+}
+
+CollisionBlock::CollisionBlock()
+{
+    ids_.reserve(INITIAL_CAPACITY);
+    pos_x_.reserve(INITIAL_CAPACITY);
+    pos_y_.reserve(INITIAL_CAPACITY);
+    vel_x_.reserve(INITIAL_CAPACITY);
+    vel_y_.reserve(INITIAL_CAPACITY);
+    radius_.reserve(INITIAL_CAPACITY);
+    awake_.reserve(INITIAL_CAPACITY);
+    woken_.reserve(INITIAL_CAPACITY);
+    gaps_.resize(INITIAL_CAPACITY);
+}
+
+void CollisionBlock::clear()
+{
+    ids_.clear();
+    pos_x_.clear();
+    pos_y_.clear();
+    vel_x_.clear();
+    vel_y_.clear();
+    radius_.clear();
+    awake_.clear();
+    woken_.clear();
+}
+
+void CollisionBlock::gather(const ParticleStore& particles, std::span<const ParticleIndex> ids)
+{
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto vxs = particles.velocityX();
+    const auto vys = particles.velocityY();
+    const auto radii = particles.radii();
+    const auto awake = particles.awake();
+
+    for (const auto id : ids)
+    {
+        awake_.push_back(awake[id]);
+        ids_.push_back(id);
+        pos_x_.push_back(xs[id]);
+        pos_y_.push_back(ys[id]);
+        vel_x_.push_back(vxs[id]);
+        vel_y_.push_back(vys[id]);
+        radius_.push_back(radii[id]);
+    }
+}
+
+void CollisionBlock::scatter(ParticleStore& particles) const
+{
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto vxs = particles.velocityX();
+    const auto vys = particles.velocityY();
+
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+        const auto id = ids_[i];
+        xs[id] = pos_x_[i];
+        ys[id] = pos_y_[i];
+        vxs[id] = vel_x_[i];
+        vys[id] = vel_y_[i];
+    }
+
+    const auto awake = particles.awake();
+    const auto rest_steps = particles.restSteps();
+    for (const auto i : woken_)
+    {
+        awake[ids_[i]] = 1.0f;
+        rest_steps[ids_[i]] = 0;
+    }
+}
+
+float CollisionBlock::resolveCell(ParticleStore& particles, const FixedGrid& grid, int row, int col, const SleepSettings& sleep)
+{
+    const auto own = grid.cellParticles(row, col);
+    if (own.empty())
+    {
+        return 0.0f;
+    }
+
+    auto awake_in = [&](int r, int c) -> size_t
+    {
+        return r >= 0 && r < grid.rows() && c >= 0 && c < grid.columns() ? grid.awakeInCell(r, c) : 0;
+    };
+
+    if (awake_in(row, col) + awake_in(row - 1, col - 1) + awake_in(row - 1, col) + awake_in(row, col - 1) + awake_in(row + 1, col - 1) == 0)
+    {
+        return 0.0f;
+    }
+
+    PARTICLESIM_PROFILE_COUNT(ProfileCounter::NeighbourQueries, 1);
+    clear();
+    const size_t own_count = gatherCell(particles, grid, row, col);
+    return resolveGathered(particles, own_count, sleep);
+}
+
+float CollisionBlock::resolveCoarseCell(ParticleStore& particles, std::span<const FixedGrid> levels, size_t level, int row,
+                                        int col, const SleepSettings& sleep)
+{
+    const FixedGrid& grid = levels[level];
+    if (grid.cellParticles(row, col).empty())
+    {
+        return 0.0f;
+    }
+
+    // Pairs within the level first, exactly like the finest level
+    float max_overlap = resolveCell(particles, grid, row, col, sleep);
+
+    // Then each particle of the cell against the finer cells within its reach. A cell's particles reach at most half a
+    // cell past its edges plus the radius of a finer particle, so this stays inside the neighbouring coarse columns.
+    for (const auto id : grid.cellParticles(row, col))
+    {
+        for (size_t j = 0; j < level; ++j)
+        {
+            const FixedGrid& finer = levels[j];
+            const int shift = static_cast<int>(std::lround(std::log2(grid.cellSize() / finer.cellSize())));
+            const Vec2f position{particles.positionX()[id], particles.positionY()[id]};
+            const float reach = particles.radii()[id] + 0.5f * finer.cellSize();
+
+            const Vec2i first = finer.getCell(position - Vec2f{reach, reach});
+            const Vec2i last = finer.getCell(position + Vec2f{reach, reach});
+            const int first_col = std::max(first[1], (col - 1) << shift);
+            const int last_col = std::min(last[1], ((col + 2) << shift) - 1);
+
+            PARTICLESIM_PROFILE_COUNT(ProfileCounter::NeighbourQueries, 1);
+            clear();
+            gather(particles, std::span<const ParticleIndex>{&id, 1});
+            for (int r = first[0]; r <= last[0]; ++r)
+            {
+                for (int c = first_col; c <= last_col; ++c)
+                {
+                    gather(particles, finer.cellParticles(r, c));
+                }
+            }
+
+            // Without the per-cell counts of every finer cell at hand, check the gathered particles themselves
+            if (std::find(awake_.begin(), awake_.end(), 1.0f) != awake_.end())
+            {
+                max_overlap = std::max(max_overlap, resolveGathered(particles, 1, sleep));
+            }
+        }
+    }
+
+    return max_overlap;
+}
+
+size_t CollisionBlock::gatherCell(const ParticleStore& particles, const FixedGrid& grid, int row, int col)
+{
+    gather(particles, grid.cellParticles(row, col));
+    const size_t own_count = ids_.size();
+
+    auto gather_cell = [&](int r, int c)
+    {
+        if (r >= 0 && r < grid.rows() && c >= 0 && c < grid.columns())
+        {
+            gather(particles, grid.cellParticles(r, c));
+        }
+    };
+
+    gather_cell(row - 1, col - 1);
+    gather_cell(row - 1, col);
+    gather_cell(row, col - 1);
+    gather_cell(row + 1, col - 1);
+    return own_count;
+}
+
+float CollisionBlock::resolveGathered(ParticleStore& particles, size_t own_count, const SleepSettings& sleep)
+{
+    max_overlap_ = 0.0f;
+
+    // The own cell's later particles and every gathered neighbour follow each other, so one range covers both
+    for (size_t i = 0; i < own_count; ++i)
+    {
+        collide(i, i + 1, ids_.size(), sleep);
+    }
+
+    scatter(particles);
+    return max_overlap_;
+}
+
+void CollisionBlock::collide(size_t i, size_t first, size_t last, const SleepSettings& sleep)
+{
+    if (first >= last)
+    {
+        return;
+    }
+
+    const float x = pos_x_[i];
+    const float y = pos_y_[i];
+    const float r = radius_[i];
+
+    const size_t count = last - first;
+    PARTICLESIM_PROFILE_COUNT(ProfileCounter::PairsTested, count);
+    if (gaps_.size() < count)
+    {
+        gaps_.resize(count);
+    }
+
+    const float* xs = pos_x_.data() + first;
+    const float* ys = pos_y_.data() + first;
+    const float* radii = radius_.data() + first;
+    float* gaps = gaps_.data();
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        const float dx = x - xs[k];
+        const float dy = y - ys[k];
+        const float reach = 2.0f * r + radii[k];
+        gaps[k] = dx * dx + dy * dy - reach * reach;
+    }
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        if (gaps[k] <= 0.0f)
+        {
+            resolvePair(i, first + k, sleep);
+        }
+    }
+}
+
+void CollisionBlock::resolvePair(size_t i, size_t j, const SleepSettings& sleep)
+{
+    if (awake_[i] == 0.0f && awake_[j] == 0.0f)
+    {
+        return;
+    }
+
+    const float axis_x = pos_x_[i] - pos_x_[j];
+    const float axis_y = pos_y_[i] - pos_y_[j];
+    const float dist2 = axis_x * axis_x + axis_y * axis_y;
+    const float min_dist = radius_[i] + radius_[j];
+
+    if (dist2 > min_dist * min_dist)
+    {
+        return;
+    }
+
+    PARTICLESIM_PROFILE_COUNT(ProfileCounter::PairsResolved, 1);
+    const float dist = std::sqrt(dist2);
+    float norm_x = 0.0f;
+    float norm_y = -1.0f;
+
+    // Particles clamped into the same corner can sit exactly on top of each other, push those apart vertically
+    if (dist > 0.0f)
+    {
+        norm_x = axis_x / dist;
+        norm_y = axis_y / dist;
+    }
+
+    const float overlap = (min_dist - dist) / min_dist;
+    max_overlap_ = std::max(max_overlap_, overlap);
+
+    // One of the two is asleep: wake it if the contact is hard enough, otherwise it stays put and the other one moves
+    bool move_i = true;
+    bool move_j = true;
+    if (awake_[i] == 0.0f || awake_[j] == 0.0f)
+    {
+        const size_t sleeper = awake_[i] == 0.0f ? i : j;
+        const size_t mover = sleeper == i ? j : i;
+        const float speed2 = vel_x_[mover] * vel_x_[mover] + vel_y_[mover] * vel_y_[mover];
+
+        if (overlap > sleep.wake_overlap || speed2 > sleep.wake_speed * sleep.wake_speed)
+        {
+            awake_[sleeper] = 1.0f;
+            woken_.push_back(sleeper);
+        }
+        else
+        {
+            move_i = sleeper != i;
+            move_j = sleeper != j;
+        }
+    }
+
+    const float delta = (move_i && move_j ? 0.5f : 1.0f) * std::abs(dist - min_dist);
+
+    // Assuming mass is equal
+    const float normal_speed = norm_x * (vel_x_[i] - vel_x_[j]) + norm_y * (vel_y_[i] - vel_y_[j]);
+    const float dv_x = normal_speed * norm_x;
+    const float dv_y = normal_speed * norm_y;
+
+    if (move_i)
+    {
+        pos_x_[i] += norm_x * delta;
+        pos_y_[i] += norm_y * delta;
+        changeVelocity(vel_x_[i], vel_y_[i], -dv_x, -dv_y);
+    }
+
+    if (move_j)
+    {
+        pos_x_[j] += norm_x * -delta;
+        pos_y_[j] += norm_y * -delta;
+        changeVelocity(vel_x_[j], vel_y_[j], dv_x, dv_y);
+    }
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "fixed_grid.h"
+#include "particle_store.h"
+#include "sleep.h"
+
+namespace sim {
+
+/*
+Resolves collisions one grid cell at a time. The particles of a cell and of its half neighbourhood (up-left, up, left
+and down-left) are gathered into contiguous arrays, every overlapping pair involving the cell is pushed apart there,
+and the results are scattered back to the store. Each pair is resolved exactly once per pass.
+
+The pair loop first measures the distance to every candidate in a branch free loop the compiler can vectorise, then
+resolves only the pairs that measurement flagged. Flagging uses a margin of the particle's own radius, since the
+particle keeps moving as its earlier overlaps are resolved; each flagged pair is tested again exactly before it is
+resolved.
+
+When particles of different sizes live in separate grids (see ParticleManager), cells of a coarser grid are also
+resolved against every particle of the finer grids within reach, so pairs across sizes are resolved once, by the
+bigger particle.
+
+Cells whose whole neighbourhood is asleep are skipped without gathering anything. Pairs of sleepers are never
+resolved; a sleeper touched by an awake particle is either woken, if the contact is fast or deep enough, or held in
+place while the awake particle takes the whole correction.
+
+One block holds scratch space for one thread. Blocks keep their capacity, so once warmed up a pass does not allocate.
+*/
+class CollisionBlock
+{
+public:
+    // Starts out with room for INITIAL_CAPACITY particles, so that a block rarely grows after its first few cells
+    CollisionBlock();
+
+    // Touches only the given cell's column and the column to its left. Returns the deepest overlap found, as a fraction
+    // of the pair's combined radii, or 0 if nothing overlapped.
+    float resolveCell(ParticleStore& particles, const FixedGrid& grid, int row, int col, const SleepSettings& sleep);
+
+    // Resolves a cell of levels[level] the same way, then each of its particles against the finer levels before it.
+    // Every grid must share the same origin and have cells a power of two smaller than the next. Reaches one coarse
+    // column either side, so touches only columns col - 1 to col + 1.
+    float resolveCoarseCell(ParticleStore& particles, std::span<const FixedGrid> levels, size_t level, int row, int col,
+                            const SleepSettings& sleep);
+
+private:
+    void clear();
+    void gather(const ParticleStore& particles, std::span<const ParticleIndex> ids);
+    void scatter(ParticleStore& particles) const;
+
+    // Gathers the cell followed by its up-left, up, left and down-left neighbours, returns the cell's particle count
+    size_t gatherCell(const ParticleStore& particles, const FixedGrid& grid, int row, int col);
+
+    // Resolves the first own_count gathered particles against everything after them and scatters the results
+    float resolveGathered(ParticleStore& particles, size_t own_count, const SleepSettings& sleep);
+
+    // Resolves particle i against the particles in [first, last)
+    void collide(size_t i, size_t first, size_t last, const SleepSettings& sleep);
+    void resolvePair(size_t i, size_t j, const SleepSettings& sleep);
+
+private:
+    std::vector<ParticleIndex> ids_;
+    std::vector<float> pos_x_;
+    std::vector<float> pos_y_;
+    std::vector<float> vel_x_;
+    std::vector<float> vel_y_;
+    std::vector<float> radius_;
+    std::vector<float> awake_;
+
+    // Block indices of sleepers woken while resolving the current cell
+    std::vector<size_t> woken_;
+
+    // Squared distance minus squared reach for each candidate of the particle being resolved
+    std::vector<float> gaps_;
+
+    // Deepest overlap seen by the current resolveCell() call
+    float max_overlap_{0.0f};
+
+    static constexpr size_t INITIAL_CAPACITY = 1024;
+};
+
+}
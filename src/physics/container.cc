@@ -9,7 +9,7 @@ void Container::centerInside(std::pair<float, float> x_bounds, std::pair<float,
     position_ = midpoint(Vec2f{x_min, y_max}, Vec2f{x_max, y_min});
 }
 
-Container::BoundsType Container::getBounds(float margin)
+Container::BoundsType Container::getBounds(float margin) const
 {
     // Container is centered, so we add/subtract half the size to get bounds
     float x_min, x_max, y_min, y_max;
@@ -21,19 +21,20 @@ Container::BoundsType Container::getBounds(float margin)
     return {Vec2f{x_min, x_max}, Vec2f{y_min, y_max}};
 }
 
-void Container::handleResize(sf::Event::KeyEvent& key_event)
+void Container::handleResize(ResizeDirection direction)
 {
-    switch(key_event.code)
+    // Never shrinks below one tick, the unsigned size would wrap around
+    switch(direction)
     {
-        case sf::Keyboard::Up    : size_[1] += sizeTick; break;
-        case sf::Keyboard::Right : size_[0] += sizeTick; break;
-        case sf::Keyboard::Down  : size_[1] -= sizeTick; break;
-        case sf::Keyboard::Left  : size_[0] -= sizeTick; break;
+        case ResizeDirection::Up    : size_[1] += sizeTick; break;
+        case ResizeDirection::Right : size_[0] += sizeTick; break;
+        case ResizeDirection::Down  : size_[1] -= size_[1] > sizeTick ? sizeTick : 0u; break;
+        case ResizeDirection::Left  : size_[0] -= size_[0] > sizeTick ? sizeTick : 0u; break;
         default: break;
     }
 }
 
-bool Container::intersects(float x, float y)
+bool Container::intersects(float x, float y) const
 {
     const auto& [x_bounds, y_bounds] = getBounds();
     const auto& [x_min, x_max] = x_bounds;
@@ -1,10 +1,19 @@
 #pragma once
-#include <SFML/Window/Event.hpp>
+#include <utility>
+
 #include "common/constants.h"
 #include "common/vector.h"
 
 namespace sim {
 
+enum class ResizeDirection
+{
+    Up,
+    Right,
+    Down,
+    Left
+};
+
 /*
 A simple container class that defines the boundaries of the world that the particles will use
 */
@@ -50,11 +59,17 @@ public:
         position_ = pos;
     }
 
+    void setSize(const Vec2u& size)
+    {
+        size_ = size;
+    }
+
     using BoundsType = std::pair<Vec2f, Vec2f>;
-    BoundsType getBounds(float margin = 0.0f);
+    BoundsType getBounds(float margin = 0.0f) const;
 
-    void handleResize(sf::Event::KeyEvent& key_event);
-    bool intersects(float x, float y);
+    // Up and Right grow the height or width by one tick, Down and Left shrink it, always about the centre
+    void handleResize(ResizeDirection direction);
+    bool intersects(float x, float y) const;
 
 private:
     static constexpr unsigned int sizeTick = 2 * static_cast<unsigned int>(MAX_RADIUS);
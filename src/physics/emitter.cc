@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#include "common/constants.h"
+
+#include "emitter.h"
+
+namespace sim {
+
+Emitter::Emitter(const Settings& settings)
+    : settings_{settings}
+{
+    if (!(settings.min_radius > 0.0f && settings.min_radius <= settings.max_radius && settings.max_radius <= MAX_RADIUS))
+    {
+        throw std::invalid_argument("emitter radii must satisfy 0 < min_radius <= max_radius <= MAX_RADIUS");
+    }
+
+    if (!(settings.rate >= 0.0f))
+    {
+        throw std::invalid_argument("emitter rate must not be negative");
+    }
+
+    if (!(settings.speed_spread >= 0.0f && settings.speed_spread <= 1.0f && settings.angle_spread >= 0.0f
+          && settings.angle_spread <= std::numbers::pi_v<float>))
+    {
+        throw std::invalid_argument("emitter speed spread must lie in [0, 1] and angle spread in [0, pi]");
+    }
+}
+
+void Emitter::emit(float dt, Random& random, std::vector<ParticleSpawn>& batch)
+{
+    if (settings_.rate <= 0.0f || dt <= 0.0f || finished())
+    {
+        return;
+    }
+
+    pending_ += static_cast<double>(settings_.rate) * static_cast<double>(dt);
+    const size_t due = allowance(static_cast<size_t>(pending_));
+    pending_ -= static_cast<double>(due);
+
+    // The k-th particle from the end became due k / rate seconds after the last one, plus whatever is still pending
+    for (size_t k = due; k > 0; --k)
+    {
+        const double age = (pending_ + static_cast<double>(k - 1)) / static_cast<double>(settings_.rate);
+        batch.push_back(make(random, static_cast<float>(age)));
+    }
+    emitted_ += due;
+
+    if (finished())
+    {
+        pending_ = 0.0;
+    }
+}
+
+void Emitter::burst(size_t count, Random& random, std::vector<ParticleSpawn>& batch)
+{
+    const size_t allowed = allowance(count);
+    batch.reserve(batch.size() + allowed);
+    for (size_t i = 0; i < allowed; ++i)
+    {
+        batch.push_back(make(random, 0.0f));
+    }
+    emitted_ += allowed;
+}
+
+size_t Emitter::allowance(size_t count) const
+{
+    return settings_.limit > 0 ? std::min(count, settings_.limit - std::min(emitted_, settings_.limit)) : count;
+}
+
+ParticleSpawn Emitter::make(Random& random, float age)
+{
+    ParticleSpawn spawn;
+
+    // Draws happen in a fixed order whatever the settings, so a given seed always lays out the same particles
+    const float u = random.uniform(0.0f, 1.0f);
+    const float v = random.uniform(0.0f, 1.0f);
+    switch (settings_.shape)
+    {
+        case EmitterShape::Point: spawn.position = settings_.position; break;
+        case EmitterShape::Line : spawn.position = settings_.position + settings_.extent * u; break;
+        case EmitterShape::Area : spawn.position = settings_.position + Vec2f{settings_.extent.x * u, settings_.extent.y * v}; break;
+    }
+
+    const float turn = random.uniform(-settings_.angle_spread, settings_.angle_spread);
+    const float scale = 1.0f + random.uniform(-settings_.speed_spread, settings_.speed_spread);
+    const float cos_turn = std::cos(turn);
+    const float sin_turn = std::sin(turn);
+    const Vec2f& velocity = settings_.velocity;
+    spawn.velocity = Vec2f{velocity.x * cos_turn - velocity.y * sin_turn, velocity.x * sin_turn + velocity.y * cos_turn} * scale;
+    spawn.position += spawn.velocity * age;
+
+    const float log_min = std::log(settings_.min_radius);
+    const float log_max = std::log(settings_.max_radius);
+    spawn.radius = std::clamp(std::exp(random.uniform(log_min, log_max)), settings_.min_radius, settings_.max_radius);
+
+    return spawn;
+}
+
+}
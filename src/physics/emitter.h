@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "common/utils.h"
+#include "common/vector.h"
+
+namespace sim {
+
+// One particle for ParticleManager::spawn() to create
+struct ParticleSpawn
+{
+    Vec2f position;
+    Vec2f velocity;
+    float radius = 10.0f;
+};
+
+enum class EmitterShape
+{
+    Point,  // every particle starts at position
+    Line,   // spread evenly at random along the segment from position to position + extent
+    Area    // spread evenly at random over the rectangle with top left corner position and size extent
+};
+
+/*
+Creates particles from a point, along a line or over an area, in one-off bursts or as a steady stream at a given rate.
+Velocities point along velocity, turned by up to angle_spread radians either way and scaled by up to speed_spread of
+its length either way. Radii are log-uniform between min_radius and max_radius, as many particles per doubling of the
+radius, so mixed sizes are not dominated by the big ones.
+
+A stream keeps the fraction of a particle left over from each call for the next, so any rate comes out right on
+average whatever the timestep. Particles that would have left the emitter during the call are moved along their
+velocity by the time since, so a fast stream comes out as an evenly spaced jet rather than in clumps once per step.
+*/
+class Emitter
+{
+public:
+    struct Settings
+    {
+        EmitterShape shape = EmitterShape::Point;
+        Vec2f position;
+        Vec2f extent;
+
+        float rate = 0.0f;              // particles per second for emit(), 0 only emits through burst()
+        size_t limit = 0;               // total particles after which the emitter stops, 0 never stops
+
+        Vec2f velocity;
+        float angle_spread = 0.0f;
+        float speed_spread = 0.0f;
+
+        float min_radius = 10.0f;
+        float max_radius = 10.0f;
+    };
+
+    // Throws std::invalid_argument unless 0 < min_radius <= max_radius <= MAX_RADIUS, the rate is not negative and both
+    // spreads are in [0, 1] and [0, pi]
+    explicit Emitter(const Settings& settings);
+
+    // Appends the particles due over the next dt seconds of the stream to batch
+    void emit(float dt, Random& random, std::vector<ParticleSpawn>& batch);
+
+    // Appends count particles at once, fewer if the limit is reached first
+    void burst(size_t count, Random& random, std::vector<ParticleSpawn>& batch);
+
+    const Settings& settings() const
+    {
+        return settings_;
+    }
+
+    // Particles created so far, and whether the limit has been reached
+    size_t emitted() const
+    {
+        return emitted_;
+    }
+
+    bool finished() const
+    {
+        return settings_.limit > 0 && emitted_ >= settings_.limit;
+    }
+
+private:
+    // A new particle that left the emitter age seconds ago
+    ParticleSpawn make(Random& random, float age);
+
+    size_t allowance(size_t count) const;
+
+    Settings settings_;
+    double pending_{0.0};
+    size_t emitted_{0};
+};
+
+}
@@ -1,94 +1,354 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
 #include "fixed_grid.h"
 
 namespace sim {
 
-FixedGrid::FixedGrid(const Vec2f& top_left, const Vec2f& bottom_right)
+namespace {
+
+// Grows the capacity by at least half whenever it runs out, so a grid that grows a row or column at a time only
+// reallocates now and then
+template <typename T>
+void assignGrowing(std::vector<T>& array, size_t count, const T& value)
+{
+    if (count > array.capacity())
+    {
+        array.reserve(std::max(count, array.capacity() + array.capacity() / 2));
+    }
+
+    array.assign(count, value);
+}
+
+}
+
+FixedGrid::FixedGrid(const Vec2f& top_left, const Vec2f& bottom_right, float cell_size, GridStorage storage)
     : top_left_{top_left}
     , bottom_right_{bottom_right}
+    , cell_size_{cell_size}
+    , storage_{storage}
 {
-    rows_ = static_cast<int>(( bottom_right_.y - top_left_.y ) / CELL_SIZE);
-    cols_ = static_cast<int>(( bottom_right_.x - top_left_.x ) / CELL_SIZE);
-    grid_.resize(rows_ * cols_);
+    reset();
 }
 
 void FixedGrid::reset()
 {
-    rows_ = static_cast<int>(( bottom_right_.y - top_left_.y ) / CELL_SIZE);
-    cols_ = static_cast<int>(( bottom_right_.x - top_left_.x ) / CELL_SIZE);
-    grid_.clear();
-    grid_.resize(rows_ * cols_);
+    // Round up so that particles resting on the far walls still land inside the grid
+    rows_ = std::max(1, static_cast<int>(std::ceil(( bottom_right_.y - top_left_.y ) / cell_size_)));
+    cols_ = std::max(1, static_cast<int>(std::ceil(( bottom_right_.x - top_left_.x ) / cell_size_)));
+    cell_particles_.clear();
+    particle_cell_.clear();
+
+    if (storage_ == GridStorage::Dense)
+    {
+        const auto cell_count = static_cast<size_t>(rows_) * static_cast<size_t>(cols_);
+        assignGrowing<size_t>(cell_start_, cell_count + 1, 0);
+        assignGrowing<size_t>(cell_cursor_, cell_count, 0);
+        assignGrowing<size_t>(cell_awake_, cell_count, 0);
+        return;
+    }
+
+    // Keys are cell indices, which change with the column count, so every slot is freed. The column index is the only
+    // array that grows with the container, and only with its width.
+    clearSlots();
+    if (slots_.empty())
+    {
+        resizeSlots(MIN_SLOTS);
+    }
+
+    cell_keys_.clear();
+    cell_start_.assign(1, 0);
+    cell_awake_.clear();
+    assignGrowing<size_t>(column_start_, static_cast<size_t>(cols_) + 1, 0);
+    column_cells_.clear();
+}
+
+void FixedGrid::reshape(const Vec2f& top_left, const Vec2f& bottom_right, float cell_size, GridStorage storage)
+{
+    // Switching storage starts from a fresh grid, so the arrays of the old layout are released
+    if (storage != storage_)
+    {
+        *this = FixedGrid{top_left, bottom_right, cell_size, storage};
+        return;
+    }
+
+    top_left_ = top_left;
+    bottom_right_ = bottom_right;
+    cell_size_ = cell_size;
+    reset();
+}
+
+size_t FixedGrid::memoryUsage() const
+{
+    size_t bytes = 0;
+    for (const auto* array : {&cell_start_, &cell_cursor_, &particle_cell_, &cell_awake_, &cell_keys_, &column_start_,
+                              &column_cells_, &used_slots_, &used_keys_, &used_count_, &used_awake_, &particle_slot_,
+                              &used_order_, &sort_scratch_, &row_start_})
+    {
+        bytes += array->capacity() * sizeof(size_t);
+    }
+
+    return bytes + cell_particles_.capacity() * sizeof(Particle::id_type) + slots_.capacity() * sizeof(Slot);
+}
+
+void FixedGrid::resizeSlots(size_t count)
+{
+    slots_.assign(count, Slot{NO_CELL, 0});
+    slot_shift_ = 64 - std::countr_zero(count);
+}
+
+void FixedGrid::clearSlots()
+{
+    for (const auto slot : used_slots_)
+    {
+        slots_[slot].key = NO_CELL;
+    }
+    used_slots_.clear();
 }
 
-Vec2i FixedGrid::getCell(const Vec2f& position)
+Vec2i FixedGrid::getCell(const Vec2f& position) const
 {
     const Vec2f rel_pos = position - top_left_;
-    const int c = static_cast<int>(rel_pos.x / CELL_SIZE);
-    const int r = static_cast<int>(rel_pos.y / CELL_SIZE);
+    const int c = std::clamp(static_cast<int>(rel_pos.x / cell_size_), 0, cols_ - 1);
+    const int r = std::clamp(static_cast<int>(rel_pos.y / cell_size_), 0, rows_ - 1);
     return Vec2i{r, c};
 }
 
-size_t FixedGrid::getIndex(const Vec2i& cell)
+void FixedGrid::rebuild(const ParticleStore& particles)
 {
-    return cell[0] * cols_ + cell[1];
+    beginRebuild(particles);
+    locate(particles, 0, particles.size());
+    finishRebuild(particles);
 }
 
-void FixedGrid::add(Particle& entity)
+void FixedGrid::rebuild(const ParticleStore& particles, std::span<const uint8_t> levels, uint8_t level)
 {
-    const Vec2i cell = getCell(entity.position());
-    entity.setRegion(cell);
-    const auto idx = getIndex(cell);
-    grid_[idx].push_back(entity.id());
+    beginRebuild(particles);
+    locate(particles, levels, level, 0, particles.size());
+    finishRebuild(particles);
 }
 
-void FixedGrid::remove(Particle& entity)
+void FixedGrid::beginRebuild(const ParticleStore& particles)
 {
-    const Vec2i cell = entity.region();
-    const auto idx = getIndex(cell);
-    auto it = grid_[idx].find(entity.
-    id());
-    grid_[idx].erase(it);
+    particle_cell_.resize(particles.size());
 }
 
-std::vector<Particle::id_type> FixedGrid::getNearby(Particle& entity)
+void FixedGrid::locate(const ParticleStore& particles, size_t first, size_t last)
 {
-    std::vector<Particle::id_type> neighbours;
+    locateRange(particles, first, last, [](size_t) { return true; });
+}
 
-    const Vec2i cell = entity.region();
+void FixedGrid::locate(const ParticleStore& particles, std::span<const uint8_t> levels, uint8_t level, size_t first, size_t last)
+{
+    locateRange(particles, first, last, [&](size_t i) { return levels[i] == level; });
+}
 
-    // This loop adds all neighbours from top-left, top, left and same cell
-    for (int dx = -1; dx <= 0; ++dx)
+template <typename Filter>
+void FixedGrid::locateRange(const ParticleStore& particles, size_t first, size_t last, Filter&& include)
+{
+    PARTICLESIM_PROFILE_SCOPE(ProfileZone::GridRebuild);
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    for (size_t i = first; i < last; ++i)
     {
-        for (int dy = -1; dy <= 0; ++dy)
+        particle_cell_[i] = include(i) ? getIndex(getCell(Vec2f{xs[i], ys[i]})) : NO_CELL;
+    }
+}
+
+void FixedGrid::finishRebuild(const ParticleStore& particles)
+{
+    PARTICLESIM_PROFILE_SCOPE(ProfileZone::GridRebuild);
+    if (storage_ == GridStorage::Sparse)
+    {
+        finishSparse(particles);
+        return;
+    }
+
+    const auto awake = particles.awake();
+    const size_t cell_count = cell_start_.size() - 1;
+    std::fill(cell_start_.begin(), cell_start_.end(), 0);
+    std::fill(cell_awake_.begin(), cell_awake_.end(), 0);
+
+    // Count the particles in each cell, shifted by one so the prefix sum yields start offsets
+    size_t bucketed = 0;
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        if (particle_cell_[i] == NO_CELL)
         {
-            const Vec2i new_cell = cell + Vec2i{dx, dy};
-            if (new_cell.x < 0 || new_cell.x >= rows_ || new_cell.y < 0 || new_cell.y >= cols_)
-            {
-                continue;
-            }
-
-            const auto idx = getIndex(new_cell);
-
-            for (const auto id : grid_[idx])
-            {
-                if (id == entity.id()) { continue; }
-                neighbours.push_back(id);
-            }
+            continue;
         }
+
+        ++cell_start_[particle_cell_[i] + 1];
+        cell_awake_[particle_cell_[i]] += awake[i] > 0.0f;
+        ++bucketed;
     }
 
-    // Add neighbours from bottom-left cell
-    const Vec2i bl_cell{cell.x + 1, cell.y - 1};
-    if (bl_cell.x < rows_ && bl_cell.y > 0)
+    for (size_t c = 0; c < cell_count; ++c)
     {
-        const auto idx = getIndex(bl_cell);
-        for (const auto id : grid_[idx])
-            {
-                neighbours.push_back(id);
-            }
+        cell_start_[c + 1] += cell_start_[c];
     }
 
-    return neighbours;
+    // Scatter the ids into their cells, this keeps ids within a cell in ascending order
+    cell_particles_.resize(bucketed);
+    cell_cursor_.assign(cell_start_.begin(), cell_start_.end() - 1);
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        if (particle_cell_[i] != NO_CELL)
+        {
+            cell_particles_[cell_cursor_[particle_cell_[i]]++] = static_cast<Particle::id_type>(i);
+        }
+    }
+}
+
+void FixedGrid::finishSparse(const ParticleStore& particles)
+{
+    const auto awake = particles.awake();
+    const auto rows = static_cast<size_t>(rows_);
+    const auto cols = static_cast<size_t>(cols_);
+    particle_slot_.resize(particles.size());
+
+    // At most half full even if every particle ends up in a cell of its own, so probes stay short. No particle count
+    // can occupy more cells than that either, so reserving for it keeps later rebuilds from allocating.
+    clearSlots();
+    const size_t slot_count = std::bit_ceil(std::max(MIN_SLOTS, 2 * particles.size()));
+    if (slots_.size() < slot_count)
+    {
+        resizeSlots(slot_count);
+    }
+
+    for (auto* array : {&used_slots_, &used_keys_, &used_count_, &used_awake_})
+    {
+        array->clear();
+    }
+
+    for (auto* array : {&used_slots_, &used_keys_, &used_count_, &used_awake_, &used_order_, &sort_scratch_, &cell_keys_,
+                        &cell_start_, &cell_awake_, &column_cells_})
+    {
+        array->reserve(particles.size() + 1);
+    }
+    cell_particles_.reserve(particles.size());
+    cell_cursor_.reserve(std::max(particles.size(), cols));
+
+    // Count the particles of each occupied cell, numbering the cells in the order they are first seen
+    size_t bucketed = 0;
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        const size_t key = particle_cell_[i];
+        if (key == NO_CELL)
+        {
+            continue;
+        }
+
+        const size_t slot = findSlot(key);
+        if (slots_[slot].key == NO_CELL)
+        {
+            slots_[slot] = Slot{key, used_slots_.size()};
+            used_slots_.push_back(slot);
+            used_keys_.push_back(key);
+            used_count_.push_back(0);
+            used_awake_.push_back(0);
+        }
+
+        const size_t used = slots_[slot].cell;
+        particle_slot_[i] = slot;
+        ++used_count_[used];
+        used_awake_[used] += awake[i] > 0.0f;
+        ++bucketed;
+    }
+
+    // Radix sort the occupied cells into row-major order, by column first and then stably by row. Either pass is a
+    // counting sort over one row or column of counters, so the cost follows the occupied cells and the side lengths.
+    const size_t cell_count = used_slots_.size();
+    auto counting_pass = [&](std::vector<size_t>& starts, size_t buckets, const std::vector<size_t>& from,
+                             std::vector<size_t>& to, auto&& digit) {
+        assignGrowing<size_t>(starts, buckets + 1, 0);
+        for (const auto used : from)
+        {
+            ++starts[digit(used_keys_[used]) + 1];
+        }
+
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            starts[b + 1] += starts[b];
+        }
+
+        to.resize(from.size());
+        for (const auto used : from)
+        {
+            to[starts[digit(used_keys_[used])]++] = used;
+        }
+    };
+
+    used_order_.resize(cell_count);
+    std::iota(used_order_.begin(), used_order_.end(), size_t{0});
+    counting_pass(column_start_, cols, used_order_, sort_scratch_, [cols](size_t key) { return key % cols; });
+    counting_pass(row_start_, rows, sort_scratch_, used_order_, [cols](size_t key) { return key / cols; });
+
+    // Store the cells in that order and point the table at their new places
+    cell_keys_.resize(cell_count);
+    cell_start_.resize(cell_count + 1);
+    cell_awake_.resize(cell_count);
+    cell_start_[0] = 0;
+    for (size_t c = 0; c < cell_count; ++c)
+    {
+        const size_t used = used_order_[c];
+        cell_keys_[c] = used_keys_[used];
+        cell_start_[c + 1] = cell_start_[c] + used_count_[used];
+        cell_awake_[c] = used_awake_[used];
+        slots_[used_slots_[used]].cell = c;
+    }
+
+    // Scatter the ids into their cells, this keeps ids within a cell in ascending order
+    cell_particles_.resize(bucketed);
+    cell_cursor_.assign(cell_start_.begin(), cell_start_.end() - 1);
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        if (particle_cell_[i] != NO_CELL)
+        {
+            cell_particles_[cell_cursor_[slots_[particle_slot_[i]].cell]++] = static_cast<Particle::id_type>(i);
+        }
+    }
+
+    // Group the stored cells by column, a stable counting sort keeps each column's cells in row order
+    std::fill(column_start_.begin(), column_start_.end(), 0);
+    for (const auto key : cell_keys_)
+    {
+        ++column_start_[key % cols + 1];
+    }
+
+    for (size_t c = 0; c < cols; ++c)
+    {
+        column_start_[c + 1] += column_start_[c];
+    }
+
+    column_cells_.resize(cell_count);
+    cell_cursor_.assign(column_start_.begin(), column_start_.end() - 1);
+    for (size_t c = 0; c < cell_count; ++c)
+    {
+        column_cells_[cell_cursor_[cell_keys_[c] % cols]++] = c;
+    }
+}
+
+std::span<const Particle::id_type> FixedGrid::cellParticles(int row, int col) const
+{
+    const auto idx = findCell(Vec2i{row, col});
+    if (idx == NO_CELL)
+    {
+        return {};
+    }
+
+    const auto first = cell_particles_.begin() + cell_start_[idx];
+    const auto last = cell_particles_.begin() + cell_start_[idx + 1];
+    return {first, last};
 }
 
+std::vector<Particle::id_type> FixedGrid::getNearby(Particle::id_type id) const
+{
+    std::vector<Particle::id_type> neighbours;
+    forEachNearby(id, [&](Particle::id_type other) { neighbours.push_back(other); });
+    return neighbours;
+}
 
-}
\ No newline at end of file
+}
@@ -1,39 +1,276 @@
 #pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
 
 #include "common/constants.h"
-#include "include/doubly_linked_list.h"
+#include "common/profiler.h"
 
 #include "particle.h"
 
 namespace sim {
 
+// How a FixedGrid stores its cells
+enum class GridStorage
+{
+    Dense,  // every cell of the container, indexed directly
+    Sparse  // only the occupied cells, found through a hash table
+};
+
+/*
+A uniform grid over the container that is rebuilt from scratch every step. Particles are bucketed with a counting sort,
+so the whole index lives in two flat arrays: the start offset of every cell and the particle ids sorted by cell.
+
+Dense storage keeps an entry for every cell, so its memory grows with the area of the container. Sparse storage keeps
+entries for the occupied cells only, sorted in the same row-major order, and finds them through an open addressing
+table keyed by cell index. Its memory follows the particle count, which makes huge, mostly empty worlds affordable at
+the price of a hash probe per cell lookup. Both give the same cells in the same order, so results are identical.
+
+Cells must be at least as wide as the largest particle in the grid is across. A grid can also hold just one size class
+of particles, see ParticleManager for how several grids with nested cells cover a mix of radii.
+*/
 class FixedGrid
 {
 public:
+    static constexpr float DEFAULT_CELL_SIZE = 2 * MAX_RADIUS;
+
     FixedGrid() = default;
-    FixedGrid(const Vec2f& top_left, const Vec2f& bottom_right);
+    FixedGrid(const Vec2f& top_left, const Vec2f& bottom_right, float cell_size = DEFAULT_CELL_SIZE,
+              GridStorage storage = GridStorage::Dense);
+
+    void rebuild(const ParticleStore& particles);
+
+    // Buckets only the particles with levels[i] == level. The others are left out of the grid, and neither
+    // forEachNearby() nor getNearby() may be called for them.
+    void rebuild(const ParticleStore& particles, std::span<const uint8_t> levels, uint8_t level);
+
+    // The same rebuild in steps, so the per-particle work can be spread over threads. beginRebuild() sizes the grid
+    // for the store, then locate() finds the cells of particles [first, last) and may run on disjoint ranges at the
+    // same time, and finishRebuild() sorts the particles into their cells.
+    void beginRebuild(const ParticleStore& particles);
+    void locate(const ParticleStore& particles, size_t first, size_t last);
+    void locate(const ParticleStore& particles, std::span<const uint8_t> levels, uint8_t level, size_t first, size_t last);
+    void finishRebuild(const ParticleStore& particles);
+
+    // Calls visit(id) for every other particle in the same cell and for every particle in the up, left, up-left and
+    // down-left cells, so pairs across cells are seen from one side and pairs within a cell from both. Reads straight
+    // out of the cell ranges and never allocates.
+    template <typename Visitor>
+    void forEachNearby(Particle::id_type id, Visitor&& visit) const;
+
+    // Same neighbours as forEachNearby, collected into a new vector
+    std::vector<Particle::id_type> getNearby(Particle::id_type id) const;
+
+    // Ids of the particles bucketed into the given cell by the last rebuild
+    std::span<const Particle::id_type> cellParticles(int row, int col) const;
+
+    // Number of awake particles bucketed into the given cell by the last rebuild
+    size_t awakeInCell(int row, int col) const
+    {
+        const size_t cell = findCell(Vec2i{row, col});
+        return cell != NO_CELL ? cell_awake_[cell] : 0;
+    }
 
-    void add(Particle& entity);
-    void remove(Particle& entity);
-    std::vector<Particle::id_type> getNearby(Particle& entity);
+    // Calls visit(row) for every cell of the column that holds particles, from the top down. Sparse storage goes
+    // straight to the occupied cells, dense storage skips the empty ones.
+    template <typename Visitor>
+    void forEachCellInColumn(int col, Visitor&& visit) const;
+
+    // Every id from the last rebuild, grouped by cell in row-major cell order and ascending within a cell
+    std::span<const Particle::id_type> particlesByCell() const
+    {
+        return cell_particles_;
+    }
+
+    int rows() const
+    {
+        return rows_;
+    }
+
+    int columns() const
+    {
+        return cols_;
+    }
+
+    float cellSize() const
+    {
+        return cell_size_;
+    }
+
+    GridStorage storage() const
+    {
+        return storage_;
+    }
+
+    // Bytes reserved by every array of the grid
+    size_t memoryUsage() const;
+
+    // Row and column of the cell that position falls into, clamped to the grid
+    Vec2i getCell(const Vec2f& position) const;
+
+    // Moves the grid onto new bounds, possibly with a new cell size. The arrays are reused, so this only allocates when
+    // the grid has more cells than it ever had before, or when the storage changes. Every cell is empty until the next
+    // rebuild.
+    void reshape(const Vec2f& top_left, const Vec2f& bottom_right, float cell_size, GridStorage storage = GridStorage::Dense);
 
     void reset();
 
 private:
-    Vec2i getCell(const Vec2f& position);
-    size_t getIndex(const Vec2i& cell);
+    // Slot of the sparse hash table
+    struct Slot
+    {
+        size_t key;   // cell index, NO_CELL while the slot is free
+        size_t cell;  // position of the cell in cell_keys_
+    };
+
+    size_t getIndex(const Vec2i& cell) const;
+
+    // Where the cell's range and awake count are stored, NO_CELL if sparse storage holds no such cell
+    size_t findCell(const Vec2i& cell) const;
+
+    // Slot holding key, or the free slot where it would go
+    size_t findSlot(size_t key) const;
+
+    // Replaces the table with count free slots, count must be a power of two
+    void resizeSlots(size_t count);
+
+    // Frees the slots taken by the last rebuild
+    void clearSlots();
+
+    template <typename Filter>
+    void locateRange(const ParticleStore& particles, size_t first, size_t last, Filter&& include);
+
+    void finishSparse(const ParticleStore& particles);
 
 private:
-    using StoreType = std::vector<double_linked_list<Particle::id_type>>;
-    StoreType grid_;
+    // cell_start_[i] .. cell_start_[i + 1] is the range of stored cell i inside cell_particles_, particle_cell_ maps ids
+    // to cell indices. Dense storage stores every cell at its own index, sparse storage the occupied ones in order.
+    std::vector<size_t> cell_start_;
+    std::vector<size_t> cell_cursor_;
+    std::vector<Particle::id_type> cell_particles_;
+    std::vector<size_t> particle_cell_;
+    std::vector<size_t> cell_awake_;
+
+    // Sparse storage only: the cell index of every stored cell, the table that finds them, and the stored cells of each
+    // column in column_cells_[column_start_[c]] .. column_cells_[column_start_[c + 1]]
+    std::vector<size_t> cell_keys_;
+    std::vector<Slot> slots_;
+    int slot_shift_{0};
+    std::vector<size_t> column_start_;
+    std::vector<size_t> column_cells_;
+
+    // Sparse rebuild scratch: the slots filled in order of first use with their keys and particle counts, the slot of
+    // every particle, and the radix sort that puts the filled slots in row-major order
+    std::vector<size_t> used_slots_;
+    std::vector<size_t> used_keys_;
+    std::vector<size_t> used_count_;
+    std::vector<size_t> used_awake_;
+    std::vector<size_t> particle_slot_;
+    std::vector<size_t> used_order_;
+    std::vector<size_t> sort_scratch_;
+    std::vector<size_t> row_start_;
+
+    // particle_cell_ entry of particles left out by a filtered rebuild
+    static constexpr size_t NO_CELL = static_cast<size_t>(-1);
+    static constexpr size_t MIN_SLOTS = 16;
+
     Vec2f top_left_{0.0f, 0.0f};
     Vec2f bottom_right_{0.0f, 0.0f};
 
+    float cell_size_{DEFAULT_CELL_SIZE};
     int rows_{0};
     int cols_{0};
+    GridStorage storage_{GridStorage::Dense};
+};
+
+inline size_t FixedGrid::getIndex(const Vec2i& cell) const
+{
+    return static_cast<size_t>(cell[0]) * static_cast<size_t>(cols_) + static_cast<size_t>(cell[1]);
+}
 
-    static constexpr int CELL_SIZE = static_cast<int>(2 * MAX_RADIUS);
+inline size_t FixedGrid::findSlot(size_t key) const
+{
+    // Fibonacci hashing scatters the cells of a row across the table, linear probing then walks neighbouring slots
+    const size_t mask = slots_.size() - 1;
+    size_t slot = static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> slot_shift_);
+    while (slots_[slot].key != key && slots_[slot].key != NO_CELL)
+    {
+        slot = (slot + 1) & mask;
+    }
 
-};
+    return slot;
+}
+
+inline size_t FixedGrid::findCell(const Vec2i& cell) const
+{
+    const size_t key = getIndex(cell);
+    if (storage_ == GridStorage::Dense)
+    {
+        return key;
+    }
+
+    const Slot& slot = slots_[findSlot(key)];
+    return slot.key == key ? slot.cell : NO_CELL;
+}
+
+template <typename Visitor>
+void FixedGrid::forEachCellInColumn(int col, Visitor&& visit) const
+{
+    if (storage_ == GridStorage::Dense)
+    {
+        for (int row = 0; row < rows_; ++row)
+        {
+            const size_t idx = getIndex(Vec2i{row, col});
+            if (cell_start_[idx] != cell_start_[idx + 1])
+            {
+                visit(row);
+            }
+        }
+        return;
+    }
+
+    const auto column = static_cast<size_t>(col);
+    for (size_t i = column_start_[column]; i < column_start_[column + 1]; ++i)
+    {
+        visit(static_cast<int>(cell_keys_[column_cells_[i]] / static_cast<size_t>(cols_)));
+    }
+}
+
+template <typename Visitor>
+void FixedGrid::forEachNearby(Particle::id_type id, Visitor&& visit) const
+{
+    PARTICLESIM_PROFILE_COUNT(ProfileCounter::NeighbourQueries, 1);
+    const size_t cell_idx = particle_cell_[id];
+    const int row = static_cast<int>(cell_idx / static_cast<size_t>(cols_));
+    const int col = static_cast<int>(cell_idx % static_cast<size_t>(cols_));
+
+    auto visit_cell = [&](int r, int c, bool skip_self)
+    {
+        if (r < 0 || r >= rows_ || c < 0 || c >= cols_)
+        {
+            return;
+        }
+
+        const size_t idx = findCell(Vec2i{r, c});
+        if (idx == NO_CELL)
+        {
+            return;
+        }
+
+        for (size_t i = cell_start_[idx]; i < cell_start_[idx + 1]; ++i)
+        {
+            const auto other = cell_particles_[i];
+            if (skip_self && other == id) { continue; }
+            visit(other);
+        }
+    };
+
+    // Top-left, left, top and same cell, then bottom-left
+    visit_cell(row - 1, col - 1, false);
+    visit_cell(row - 1, col, false);
+    visit_cell(row, col - 1, false);
+    visit_cell(row, col, true);
+    visit_cell(row + 1, col - 1, false);
+}
 
-}
\ No newline at end of file
+}
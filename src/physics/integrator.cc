@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#include "common/constants.h"
+
+#include "integrator_kernel.h"
+#include "integrator.h"
+
+namespace sim {
+
+namespace {
+
+bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS has to save the YMM registers for AVX to be usable at all
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+float accelerate(float vel, float delta)
+{
+    const float rel_delta = std::abs(delta) / std::abs(vel);
+    if (rel_delta < 0.001f)
+    {
+        delta = 0.0f;
+    }
+
+    return std::clamp(vel + delta, -MAX_VEL, MAX_VEL);
+}
+
+void rebound(float& pos, float& vel, float lo, float hi)
+{
+    if (pos < lo || pos > hi)
+    {
+        const float speed = std::abs(vel);
+        const float rel_delta = speed * (1 - DAMP_WALL) / speed;
+        vel = rel_delta > 0.01f ? (vel * -1) * DAMP_WALL : 0.0f;
+    }
+
+    pos = std::clamp(pos, lo, hi);
+}
+
+// Reference implementation, the vector kernels in integrator_kernel.h must match it operation for operation
+void integrateScalar(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k)
+{
+    const float half_dt = 0.5f * k.dt;
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const float ax = p.acc_x[i];
+        const float ay = p.acc_y[i];
+        const float r = p.radius[i];
+        const float dt = k.dt * p.awake[i];
+        const float half_dt_i = half_dt * p.awake[i];
+
+        const float half_vx = p.vel_x[i] + half_dt_i * ax;
+        const float half_vy = p.vel_y[i] + half_dt_i * ay;
+        float vx = accelerate(p.vel_x[i], ax * dt);
+        float vy = accelerate(p.vel_y[i], ay * dt);
+        float x = p.pos_x[i] + half_vx * dt;
+        float y = p.pos_y[i] + half_vy * dt;
+
+        rebound(x, vx, k.x_min + r, k.x_max - r);
+        rebound(y, vy, k.y_min + r, k.y_max - r);
+
+        p.pos_x[i] = x;
+        p.pos_y[i] = y;
+        p.vel_x[i] = vx;
+        p.vel_y[i] = vy;
+        p.acc_x[i] = k.base_acceleration.x;
+        p.acc_y[i] = k.base_acceleration.y;
+    }
+}
+
+}
+
+SimdLevel detectSimdLevel()
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return SimdLevel::NEON;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    if (detail::hasAvx2Kernel() && cpuSupportsAvx2())
+    {
+        return SimdLevel::AVX2;
+    }
+
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+bool isSupported(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::Scalar : return true;
+        case SimdLevel::AVX2   : return detectSimdLevel() == SimdLevel::AVX2;
+        case SimdLevel::SSE2   : return detectSimdLevel() == SimdLevel::SSE2 || detectSimdLevel() == SimdLevel::AVX2;
+        case SimdLevel::NEON   : return detectSimdLevel() == SimdLevel::NEON;
+        default                : return false;
+    }
+}
+
+const char* toString(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::SSE2 : return "sse2";
+        case SimdLevel::AVX2 : return "avx2";
+        case SimdLevel::NEON : return "neon";
+        default              : return "scalar";
+    }
+}
+
+bool fromString(const std::string& name, SimdLevel& level)
+{
+    for (const auto candidate : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::NEON})
+    {
+        if (name == toString(candidate))
+        {
+            level = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+IntegrationArrays integrationArrays(ParticleStore& particles)
+{
+    return IntegrationArrays{
+        particles.positionX().data(),
+        particles.positionY().data(),
+        particles.velocityX().data(),
+        particles.velocityY().data(),
+        particles.accelerationX().data(),
+        particles.accelerationY().data(),
+        particles.radii().data(),
+        particles.awake().data()
+    };
+}
+
+void integrateParticles(const IntegrationArrays& particles, size_t first, size_t last, const IntegrationConstants& constants, SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::AVX2 : first = detail::integrateAvx2(particles, first, last, constants); break;
+        case SimdLevel::SSE2 : first = detail::integrateSse2(particles, first, last, constants); break;
+        case SimdLevel::NEON : first = detail::integrateNeon(particles, first, last, constants); break;
+        default: break;
+    }
+
+    // Whatever did not fill a whole vector, or everything when no vector kernel is available
+    integrateScalar(particles, first, last, constants);
+}
+
+}
\ No newline at end of file
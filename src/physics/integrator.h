@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "particle_store.h"
+
+namespace sim {
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+// Best instruction set the running CPU supports among those compiled in
+SimdLevel detectSimdLevel();
+bool isSupported(SimdLevel level);
+
+const char* toString(SimdLevel level);
+bool fromString(const std::string& name, SimdLevel& level);
+
+// Raw views of the arrays the integration kernel reads and writes
+struct IntegrationArrays
+{
+    float* pos_x;
+    float* pos_y;
+    float* vel_x;
+    float* vel_y;
+    float* acc_x;
+    float* acc_y;
+    const float* radius;
+
+    // 1 for awake particles and 0 for sleeping ones, which scales their timestep to nothing
+    const float* awake;
+};
+
+struct IntegrationConstants
+{
+    float dt;
+
+    // Acceleration every particle is reset to after it has been integrated
+    Vec2f base_acceleration;
+
+    // Container walls, the radius of each particle is applied by the kernel
+    float x_min;
+    float x_max;
+    float y_min;
+    float y_max;
+};
+
+IntegrationArrays integrationArrays(ParticleStore& particles);
+
+/*
+Advances particles [first, last) by one timestep: the position moves by the half-step velocity, the velocity is updated
+and clamped to MAX_VEL, and particles that left the container are rebounded off the wall and clamped back inside.
+Sleeping particles are stepped with a timestep of zero, so they only have their acceleration reset.
+Every instruction set performs the exact same sequence of floating point operations, so all of them produce bitwise
+identical results to the scalar path.
+*/
+void integrateParticles(const IntegrationArrays& particles, size_t first, size_t last, const IntegrationConstants& constants, SimdLevel level);
+
+}
\ No newline at end of file
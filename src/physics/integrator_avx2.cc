@@ -0,0 +1,58 @@
+#include "integrator_kernel.h"
+
+// This file is the only one built with AVX2 code generation enabled, see src/physics/CMakeLists.txt
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops
+{
+    using V = __m256;
+    static constexpr size_t WIDTH = 8;
+
+    static V set1(float value) { return _mm256_set1_ps(value); }
+    static V load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+    static void store(float* ptr, V v) { _mm256_storeu_ps(ptr, v); }
+
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static V neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+
+    static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static V bitOr(V a, V b) { return _mm256_or_ps(a, b); }
+    static V select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+
+    // Same result as std::clamp, including passing NaN through, because vmaxps/vminps return their second operand then
+    static V clamp(V v, V lo, V hi) { return _mm256_min_ps(hi, _mm256_max_ps(lo, v)); }
+};
+
+}
+
+bool sim::detail::hasAvx2Kernel()
+{
+    return true;
+}
+
+size_t sim::detail::integrateAvx2(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k)
+{
+    return integrateBlocks<Avx2Ops>(p, first, last, k);
+}
+
+#else
+
+bool sim::detail::hasAvx2Kernel()
+{
+    return false;
+}
+
+size_t sim::detail::integrateAvx2(const IntegrationArrays&, size_t first, size_t, const IntegrationConstants&)
+{
+    return first;
+}
+
+#endif
\ No newline at end of file
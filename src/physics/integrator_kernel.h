@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+
+#include "common/constants.h"
+
+#include "integrator.h"
+
+/*
+The vectorised integration kernel, written once against a small set of lane operations. Every instruction set provides
+its own Ops in its own translation unit (inside an anonymous namespace, so instantiations compiled with different
+target flags never get merged by the linker). The order of operations must stay in lockstep with integrateScalar.
+*/
+namespace sim::detail {
+
+// Integrates whole blocks of Ops::WIDTH particles starting at first and returns the index of the first one left over
+template <typename Ops>
+size_t integrateBlocks(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k)
+{
+    using V = typename Ops::V;
+
+    const V dt = Ops::set1(k.dt);
+    const V half_dt = Ops::set1(0.5f * k.dt);
+    const V zero = Ops::set1(0.0f);
+    const V min_rel_delta = Ops::set1(0.001f);
+    const V min_rebound = Ops::set1(0.01f);
+    const V damp = Ops::set1(DAMP_WALL);
+    const V energy_loss = Ops::set1(1 - DAMP_WALL);
+    const V max_vel = Ops::set1(MAX_VEL);
+    const V min_vel = Ops::set1(-MAX_VEL);
+    const V base_ax = Ops::set1(k.base_acceleration.x);
+    const V base_ay = Ops::set1(k.base_acceleration.y);
+    const V x_min = Ops::set1(k.x_min);
+    const V x_max = Ops::set1(k.x_max);
+    const V y_min = Ops::set1(k.y_min);
+    const V y_max = Ops::set1(k.y_max);
+
+    // Velocity update along one axis, dropping changes that are negligible relative to the current velocity
+    auto accelerate = [&](V vel, V delta)
+    {
+        const V rel_delta = Ops::div(Ops::abs(delta), Ops::abs(vel));
+        delta = Ops::select(Ops::lt(rel_delta, min_rel_delta), zero, delta);
+        return Ops::clamp(Ops::add(vel, delta), min_vel, max_vel);
+    };
+
+    // Reflect and damp the velocity of lanes outside [lo, hi], then clamp the position back inside
+    auto rebound = [&](V& pos, V& vel, V lo, V hi)
+    {
+        const V outside = Ops::bitOr(Ops::lt(pos, lo), Ops::gt(pos, hi));
+        const V speed = Ops::abs(vel);
+        const V rel_delta = Ops::div(Ops::mul(speed, energy_loss), speed);
+        const V bounced = Ops::select(Ops::gt(rel_delta, min_rebound), Ops::mul(Ops::neg(vel), damp), zero);
+        vel = Ops::select(outside, bounced, vel);
+        pos = Ops::clamp(pos, lo, hi);
+    };
+
+    size_t i = first;
+    for (; i + Ops::WIDTH <= last; i += Ops::WIDTH)
+    {
+        V x = Ops::load(p.pos_x + i);
+        V y = Ops::load(p.pos_y + i);
+        V vx = Ops::load(p.vel_x + i);
+        V vy = Ops::load(p.vel_y + i);
+        const V ax = Ops::load(p.acc_x + i);
+        const V ay = Ops::load(p.acc_y + i);
+        const V r = Ops::load(p.radius + i);
+        const V awake = Ops::load(p.awake + i);
+        const V lane_dt = Ops::mul(dt, awake);
+        const V lane_half_dt = Ops::mul(half_dt, awake);
+
+        const V half_vx = Ops::add(vx, Ops::mul(lane_half_dt, ax));
+        const V half_vy = Ops::add(vy, Ops::mul(lane_half_dt, ay));
+        vx = accelerate(vx, Ops::mul(ax, lane_dt));
+        vy = accelerate(vy, Ops::mul(ay, lane_dt));
+        x = Ops::add(x, Ops::mul(half_vx, lane_dt));
+        y = Ops::add(y, Ops::mul(half_vy, lane_dt));
+
+        rebound(x, vx, Ops::add(x_min, r), Ops::sub(x_max, r));
+        rebound(y, vy, Ops::add(y_min, r), Ops::sub(y_max, r));
+
+        Ops::store(p.pos_x + i, x);
+        Ops::store(p.pos_y + i, y);
+        Ops::store(p.vel_x + i, vx);
+        Ops::store(p.vel_y + i, vy);
+        Ops::store(p.acc_x + i, base_ax);
+        Ops::store(p.acc_y + i, base_ay);
+    }
+
+    return i;
+}
+
+// Per instruction set entry points, each returns the index of the first particle it did not integrate
+bool hasAvx2Kernel();
+size_t integrateSse2(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k);
+size_t integrateAvx2(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k);
+size_t integrateNeon(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k);
+
+}
\ No newline at end of file
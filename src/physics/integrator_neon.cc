@@ -0,0 +1,51 @@
+#include "integrator_kernel.h"
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+
+namespace {
+
+struct NeonOps
+{
+    using V = float32x4_t;
+    static constexpr size_t WIDTH = 4;
+
+    static V set1(float value) { return vdupq_n_f32(value); }
+    static V load(const float* ptr) { return vld1q_f32(ptr); }
+    static void store(float* ptr, V v) { vst1q_f32(ptr, v); }
+
+    static V add(V a, V b) { return vaddq_f32(a, b); }
+    static V sub(V a, V b) { return vsubq_f32(a, b); }
+    static V mul(V a, V b) { return vmulq_f32(a, b); }
+    static V div(V a, V b) { return vdivq_f32(a, b); }
+    static V abs(V a) { return vabsq_f32(a); }
+    static V neg(V a) { return vnegq_f32(a); }
+
+    static V lt(V a, V b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    static V gt(V a, V b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+    static V bitOr(V a, V b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    static V select(V mask, V a, V b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+    // vmaxq/vminq propagate NaN unlike std::clamp, so build the clamp from compares instead
+    static V clamp(V v, V lo, V hi)
+    {
+        const V low_clamped = select(lt(v, lo), lo, v);
+        return select(lt(hi, low_clamped), hi, low_clamped);
+    }
+};
+
+}
+
+size_t sim::detail::integrateNeon(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k)
+{
+    return integrateBlocks<NeonOps>(p, first, last, k);
+}
+
+#else
+
+size_t sim::detail::integrateNeon(const IntegrationArrays&, size_t first, size_t, const IntegrationConstants&)
+{
+    return first;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "integrator_kernel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2Ops
+{
+    using V = __m128;
+    static constexpr size_t WIDTH = 4;
+
+    static V set1(float value) { return _mm_set1_ps(value); }
+    static V load(const float* ptr) { return _mm_loadu_ps(ptr); }
+    static void store(float* ptr, V v) { _mm_storeu_ps(ptr, v); }
+
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static V neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+
+    static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static V bitOr(V a, V b) { return _mm_or_ps(a, b); }
+    static V select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    // Same result as std::clamp, including passing NaN through, because maxps/minps return their second operand then
+    static V clamp(V v, V lo, V hi) { return _mm_min_ps(hi, _mm_max_ps(lo, v)); }
+};
+
+}
+
+size_t sim::detail::integrateSse2(const IntegrationArrays& p, size_t first, size_t last, const IntegrationConstants& k)
+{
+    return integrateBlocks<Sse2Ops>(p, first, last, k);
+}
+
+#else
+
+size_t sim::detail::integrateSse2(const IntegrationArrays&, size_t first, size_t, const IntegrationConstants&)
+{
+    return first;
+}
+
+#endif
\ No newline at end of file
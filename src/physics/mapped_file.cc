@@ -0,0 +1,126 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace sim {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        file_ = nullptr;
+        throw std::runtime_error("could not open " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size))
+    {
+        CloseHandle(file_);
+        throw std::runtime_error("could not read the size of " + path);
+    }
+
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+    {
+        CloseHandle(file_);
+        throw std::runtime_error("could not map " + path);
+    }
+
+    data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+        throw std::runtime_error("could not map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+    }
+
+    if (file_)
+    {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("could not open " + path);
+    }
+
+    struct stat info;
+    if (::fstat(fd_, &info) != 0)
+    {
+        ::close(fd_);
+        throw std::runtime_error("could not read the size of " + path);
+    }
+
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapping == MAP_FAILED)
+    {
+        ::close(fd_);
+        throw std::runtime_error("could not map " + path);
+    }
+
+    // The whole file is about to be streamed through once
+    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const std::byte*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        ::munmap(const_cast<std::byte*>(data_), size_);
+    }
+
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+#endif
+
+}
\ No newline at end of file
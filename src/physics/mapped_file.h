@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace sim {
+
+/*
+A read-only memory mapping of a whole file. Pages are only read from disk when they are first touched, which makes
+opening even very large files close to free. Throws std::runtime_error if the file cannot be opened or mapped.
+*/
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const
+    {
+        return {data_, size_};
+    }
+
+private:
+    const std::byte* data_{nullptr};
+    size_t size_{0};
+
+#ifdef _WIN32
+    void* file_{nullptr};
+    void* mapping_{nullptr};
+#else
+    int fd_{-1};
+#endif
+};
+
+}
\ No newline at end of file
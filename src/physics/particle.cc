@@ -6,51 +6,35 @@
 
 namespace sim {
 
-int Particle::nextID = 0;
-
-Particle::Particle(const Vec2f& position, float radius)
-    : position_{position}
-    , acceleration_{0, G}
-    , radius_{radius}
-    , id_{nextID++}
+Vec2f Particle::nextPosition(float timestep)
 {
-}
-
-void Particle::setVelocity(Vec2f new_velocity)
-{
-    new_velocity.clamp({-MAX_VEL, MAX_VEL}, {-MAX_VEL, MAX_VEL});
-    velocity_ = new_velocity;
-}
-
-const Vec2f& Particle::nextPosition(float timestep)
-{
-    Vec2f v_half = velocity_ + 0.5f * timestep * acceleration_;
-    changeVelocity(acceleration_ * timestep);
-    position_ += v_half * timestep;
-    acceleration_ = {0.0f, 0.0f};
+    const Vec2f accel = acceleration();
+    Vec2f v_half = velocity() + 0.5f * timestep * accel;
+    changeVelocity(accel * timestep);
+    move(v_half * timestep);
+    setAcceleration({0.0f, 0.0f});
     return position();
 }
 
 void Particle::rebound(int axis)
 {
-    const float speed_along_axis = std::abs(velocity_[axis]);
+    Vec2f new_velocity = velocity();
+    const float speed_along_axis = std::abs(new_velocity[axis]);
     const float delta = speed_along_axis * (1 - DAMP_WALL);
     const float rel_delta = delta / speed_along_axis;
 
     if (rel_delta > 0.01f)
     {
-        velocity_.reflect(axis);
-        velocity_.dilate(axis, DAMP_WALL);
+        new_velocity.reflect(axis);
+        new_velocity.dilate(axis, DAMP_WALL);
     }
     else
     {
-        velocity_[axis] = 0;
+        new_velocity[axis] = 0;
     }
-}
 
-void Particle::move(const Vec2f& pos_delta)
-{
-    position_ += pos_delta;
+    store_->vel_x_[index_] = new_velocity.x;
+    store_->vel_y_[index_] = new_velocity.y;
 }
 
 }
@@ -1,91 +1,143 @@
 #pragma once
-#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <cstdint>
 
 #include "common/constants.h"
 #include "common/vector.h"
 
 #include "container.h"
+#include "particle_store.h"
 
 namespace sim {
 
-class ParticleStore;
-
-class Particle
+// Read-only view of a single particle, what a const ParticleStore hands out. Same lifetime rules as Particle below.
+class ConstParticle
 {
 public:
-    static int nextID;
-    static const sf::Color slowColour;
-    static const sf::Color fastColour;
-    static const sf::Color midColour;
+    using id_type = ParticleIndex;
 
-    using id_type = uint16_t;
+    ConstParticle(const ParticleStore& store, size_t index)
+        : store_{&store}
+        , index_{index}
+    {
+    }
 
-    Particle(const Vec2f& position, float radius = 10.0f);
+    Vec2f position() const
+    {
+        return Vec2f{store_->pos_x_[index_], store_->pos_y_[index_]};
+    }
 
-    const Vec2f& nextPosition(float timestep);
+    Vec2f acceleration() const
+    {
+        return Vec2f{store_->acc_x_[index_], store_->acc_y_[index_]};
+    }
 
-    void move(const Vec2f& pos_delta);
+    Vec2f velocity() const
+    {
+        return Vec2f{store_->vel_x_[index_], store_->vel_y_[index_]};
+    }
 
-    const Vec2f& position() const
+    float radius() const
     {
-        return position_;
+        return store_->radius_[index_];
     }
 
-    Vec2f& position()
+    float mass() const
     {
-        return position_;
+        return store_->mass_[index_];
     }
 
-    const Vec2f& acceleration() const
+    id_type id() const
     {
-        return acceleration_;
+        return static_cast<id_type>(index_);
     }
 
-    const Vec2f& velocity() const
+    bool operator==(const ConstParticle& other) const
     {
-        return velocity_;
+        return store_ == other.store_ && index_ == other.index_;
     }
 
-    void rebound(int axis);
+private:
+    const ParticleStore* store_;
+    size_t index_;
+};
 
-    void setPosition(const Vec2f& new_position)
+/*
+A view of a single particle inside a ParticleStore. It is cheap to copy and only valid for as long as the store does not
+reallocate, so it should not be held on to across particle creation.
+*/
+class Particle
+{
+public:
+    using id_type = ParticleIndex;
+
+    Particle(ParticleStore& store, size_t index)
+        : store_{&store}
+        , index_{index}
     {
-        position_ = new_position;
     }
 
-    void setAcceleration(const Vec2f& accel)
+    Vec2f nextPosition(float timestep);
+
+    void move(const Vec2f& pos_delta)
+    {
+        store_->pos_x_[index_] += pos_delta.x;
+        store_->pos_y_[index_] += pos_delta.y;
+    }
+
+    Vec2f position() const
+    {
+        return Vec2f{store_->pos_x_[index_], store_->pos_y_[index_]};
+    }
+
+    Vec2f acceleration() const
     {
-        acceleration_ = accel;
+        return Vec2f{store_->acc_x_[index_], store_->acc_y_[index_]};
     }
 
-    void setRegion(const Vec2i& region)
+    Vec2f velocity() const
     {
-        region_ = region;
+        return Vec2f{store_->vel_x_[index_], store_->vel_y_[index_]};
     }
 
-    const Vec2i& region() const
+    void rebound(int axis);
+
+    void setPosition(const Vec2f& new_position)
     {
-        return region_;
+        store_->pos_x_[index_] = new_position.x;
+        store_->pos_y_[index_] = new_position.y;
+    }
+
+    void setAcceleration(const Vec2f& accel)
+    {
+        store_->acc_x_[index_] = accel.x;
+        store_->acc_y_[index_] = accel.y;
     }
 
     float radius() const
     {
-        return radius_;
+        return store_->radius_[index_];
     }
 
-    int id() const
+    id_type id() const
     {
-        return id_;
+        return static_cast<id_type>(index_);
     }
 
-    void setVelocity(Vec2f new_velocity);
+    void setVelocity(Vec2f new_velocity)
+    {
+        new_velocity.clamp({-MAX_VEL, MAX_VEL}, {-MAX_VEL, MAX_VEL});
+        store_->vel_x_[index_] = new_velocity.x;
+        store_->vel_y_[index_] = new_velocity.y;
+    }
 
     void changeVelocity(const Vec2f& delta_vel)
     {
+        const Vec2f current = velocity();
         auto [dx, dy] = delta_vel;
         auto rel_delta = Vec2f{std::abs(dx), std::abs(dy)};
-        rel_delta.x /= std::abs(velocity_.x);
-        rel_delta.y /= std::abs(velocity_.y);
+        rel_delta.x /= std::abs(current.x);
+        rel_delta.y /= std::abs(current.y);
 
         if (rel_delta.x < 0.001f)
         {
@@ -97,28 +149,48 @@ public:
             dy = 0.0f;
         }
 
-        setVelocity(velocity_ + Vec2f{dx, dy});
+        setVelocity(current + Vec2f{dx, dy});
     }
 
     float mass() const
     {
-        return mass_;
+        return store_->mass_[index_];
     }
 
     bool operator==(const Particle& other) const
     {
-        return id_ == other.id();
+        return store_ == other.store_ && index_ == other.index_;
+    }
+
+    operator ConstParticle() const
+    {
+        return ConstParticle{*store_, index_};
     }
 
 private:
-    Vec2f position_;
-    Vec2f prev_position_;
-    Vec2f acceleration_;
-    Vec2f velocity_;
-    float radius_;
-    float mass_;
-    Vec2i region_;
-    int id_;
+    ParticleStore* store_;
+    size_t index_;
 };
 
+inline Particle ParticleStore::operator[](size_t index)
+{
+    return Particle{*this, index};
+}
+
+inline ConstParticle ParticleStore::operator[](size_t index) const
+{
+    return ConstParticle{*this, index};
+}
+
+inline Particle ParticleStore::back()
+{
+    return Particle{*this, size() - 1};
+}
+
+template <typename StoreType>
+typename ParticleStore::basic_iterator<StoreType>::value_type ParticleStore::basic_iterator<StoreType>::operator*() const
+{
+    return (*store_)[index_];
+}
+
 }
@@ -1,62 +1,389 @@
-#include "common/utils.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+#include "common/profiler.h"
 
 #include "particle_manager.h"
 
 namespace sim {
 
-ParticleManager::ParticleManager(Container& container)
+ParticleManager::ParticleManager(Container& container, size_t thread_count)
     : container_{container}
+    , workers_{thread_count}
+    , collision_blocks_(workers_.size())
 {
-    const auto& [x_bounds, y_bounds] = container_.getBounds();
+    partitioners_.reserve(MAX_GRID_LEVELS);
+    resetPartitioner();
+    buildStepGraph();
+}
+
+void ParticleManager::buildStepGraph()
+{
+    // Every phase reads what the one before it wrote all over the store, so the step is a chain. What the graph buys
+    // is that each phase is spread by stealing, and that a phase starts on the threads already running the last one
+    // instead of waking the pool again.
+    locate_node_ = step_graph_.add([this](size_t chunk) { locateChunk(chunk); });
+    bucket_node_ = step_graph_.add([this](size_t level) { partitioners_[level].finishRebuild(particles_); }, {locate_node_});
+    sort_node_ = step_graph_.add([this](size_t) { sortParticles(); }, {bucket_node_});
+
+    TaskGraph::NodeId last = sort_node_;
+    for (size_t level = 0; level < MAX_GRID_LEVELS; ++level)
+    {
+        for (int phase = 0; phase < 3; ++phase)
+        {
+            last = step_graph_.add([this, level, phase](size_t i) { resolveCollisionPass(level, phase, i); }, {last});
+            collision_nodes_[level][static_cast<size_t>(phase)] = last;
+        }
+    }
+
+    // Sleep and statistics run on each chunk straight after it is integrated, while its particles are still in cache
+    integrate_node_ = step_graph_.add([this](size_t chunk) {
+        integrateChunk(chunk);
+
+        PARTICLESIM_PROFILE_SCOPE(ProfileZone::Integration);
+        const size_t first = chunk * PARTICLE_CHUNK;
+        const size_t last = std::min(first + PARTICLE_CHUNK, particles_.size());
+        auto& stats = chunk_stats_[chunk];
+        stats = ParticleStats{};
+        if (sleep_.enabled)
+        {
+            stats.asleep = updateSleep(particles_, sleep_, first, last);
+        }
+
+        const Vec2f area_min{step_constants_.x_min, step_constants_.y_min};
+        const Vec2f area_max{step_constants_.x_max, step_constants_.y_max};
+        stats.collect(particles_, first, last, area_min, area_max);
+    }, {last});
+}
+
+void ParticleManager::resetPartitioner()
+{
+    grid_bounds_ = container_.getBounds();
+    const auto& [x_bounds, y_bounds] = grid_bounds_;
     const Vec2f top_left{x_bounds[0], y_bounds[0]};
     const Vec2f bottom_right{x_bounds[1], y_bounds[1]};
-    partitioner_ = FixedGrid{top_left, bottom_right};
+
+    // Grids are reshaped in place and keep their arrays, so a resize or a new cell size costs a pass over the cells
+    // rather than fresh allocations
+    partitioners_.resize(cell_sizes_.size());
+    for (size_t level = 0; level < cell_sizes_.size(); ++level)
+    {
+        partitioners_[level].reshape(top_left, bottom_right, cell_sizes_[level], grid_storage_);
+    }
+
+    // The finest level has the most columns, coarser levels use the front of the same array
+    column_overlap_.assign(static_cast<size_t>(partitioners_.front().columns()), 0.0f);
 }
 
-const Particle& ParticleManager::createParticleAtCursor(float x, float y)
+void ParticleManager::chooseCellSizes()
 {
-    const float radius = 10.0f;
-    const auto& [x_bounds, y_bounds] = container_.getBounds(radius);
-    const auto& [x_min, x_max] = x_bounds;
-    const auto& [y_min, y_max] = y_bounds;
+    const auto radii = particles_.radii();
+    if (radii.empty())
+    {
+        return;
+    }
+
+    const auto [min_radius, max_radius] = std::minmax_element(radii.begin(), radii.end());
+
+    // No dense level has more than four cells per particle it holds, which would have sparse scenes spend their time
+    // walking empty cells. Sparse grids never visit empty cells, so they need no such limit. The coarsest cells fit the
+    // biggest particle and are rounded up to whole diameters, so that they only change in steps as particles come and go.
+    const float area = grid_storage_ == GridStorage::Dense
+                     ? static_cast<float>(container_.getWidth()) * static_cast<float>(container_.getHeight()) : 0.0f;
+    const float sparse_size = std::sqrt(area / (CELLS_PER_PARTICLE * static_cast<float>(radii.size())));
+    const float diameter = 2.0f * *max_radius;
+    const float coarsest = diameter * std::max(1.0f, std::ceil(sparse_size / diameter));
+
+    // Finer levels halve the cells again and again while the smallest particle still fits. One is only split off when
+    // it takes at least three quarters of the particles left above it: the few big particles left behind then do the
+    // expensive queries across levels, and the many small ones get cells that fit them.
+    // Radii are validated on the way in, but a radius of 0 would keep this halving forever, so it gets a single level.
+    std::array<float, MAX_GRID_LEVELS> sizes{coarsest};
+    size_t level_count = 1;
+    auto above = static_cast<ptrdiff_t>(radii.size());
+    for (float size = 0.5f * coarsest; *min_radius > 0.0f && size >= 2.0f * *min_radius && level_count < MAX_GRID_LEVELS; size *= 0.5f)
+    {
+        const auto fitting = std::count_if(radii.begin(), radii.end(), [&](float radius) { return 2.0f * radius <= size; });
+        if (4 * fitting < 3 * above || area > CELLS_PER_PARTICLE * static_cast<float>(fitting) * size * size)
+        {
+            continue;
+        }
+
+        // A level whose particles all moved on into this one would stay empty, this one replaces it
+        if (fitting == above)
+        {
+            --level_count;
+        }
+
+        sizes[level_count++] = size;
+        above = fitting;
+    }
+    std::reverse(sizes.begin(), sizes.begin() + level_count);
 
-    Vec2f position{x, y};
-    position.clamp({x_min, x_max}, {y_min, y_max});
+    if (!std::equal(cell_sizes_.begin(), cell_sizes_.end(), sizes.begin(), sizes.begin() + level_count))
+    {
+        cell_sizes_.assign(sizes.begin(), sizes.begin() + level_count);
+        resetPartitioner();
+    }
 
-    Particle p{position, radius};
-    partitioner_.add(p);
-    particles_.push_back(std::move(p));
+    if (level_count > 1)
+    {
+        particle_level_.resize(radii.size());
+        for (size_t i = 0; i < radii.size(); ++i)
+        {
+            uint8_t level = 0;
+            while (2.0f * radii[i] > cell_sizes_[level])
+            {
+                ++level;
+            }
+            particle_level_[i] = level;
+        }
+    }
+}
 
+Particle ParticleManager::createParticleAtCursor(float x, float y, float radius)
+{
+    const ParticleSpawn particle{Vec2f{x, y}, Vec2f{0.0f, 0.0f}, radius};
+    spawn(std::span<const ParticleSpawn>{&particle, 1});
     return particles_.back();
 }
 
+size_t ParticleManager::spawn(std::span<const ParticleSpawn> batch)
+{
+    if (std::any_of(batch.begin(), batch.end(), [](const auto& p) { return !(p.radius > 0.0f && p.radius <= MAX_RADIUS); }))
+    {
+        throw std::invalid_argument("particle radius must be greater than 0 and at most MAX_RADIUS");
+    }
+
+    const size_t first = particles_.size();
+    particles_.resize(first + batch.size());
+
+    // The walls once for the whole batch, each particle's radius is applied the same way getBounds(radius) would
+    const auto& [x_walls, y_walls] = container_.getBounds();
+    const auto xs = particles_.positionX();
+    const auto ys = particles_.positionY();
+    const auto vxs = particles_.velocityX();
+    const auto vys = particles_.velocityY();
+    const auto ays = particles_.accelerationY();
+    const auto radii = particles_.radii();
+    const auto masses = particles_.masses();
+    const auto anchor_xs = particles_.anchorX();
+    const auto anchor_ys = particles_.anchorY();
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        const auto& particle = batch[i];
+        const size_t id = first + i;
+
+        Vec2f position = particle.position;
+        position.clamp({x_walls[0] + particle.radius, x_walls[1] - particle.radius},
+                       {y_walls[0] + particle.radius, y_walls[1] - particle.radius});
+
+        xs[id] = anchor_xs[id] = position.x;
+        ys[id] = anchor_ys[id] = position.y;
+        vxs[id] = std::clamp(particle.velocity.x, -MAX_VEL, MAX_VEL);
+        vys[id] = std::clamp(particle.velocity.y, -MAX_VEL, MAX_VEL);
+        ays[id] = G;
+        radii[id] = particle.radius;
+        masses[id] = 1.0f;
+    }
+
+    return first;
+}
+
+std::vector<Emitter>& ParticleManager::emitters()
+{
+    return emitters_;
+}
+
+const std::vector<Emitter>& ParticleManager::emitters() const
+{
+    return emitters_;
+}
+
+bool ParticleManager::remove(ParticleHandle handle)
+{
+    const auto index = particles_.indexOf(handle);
+    if (!index)
+    {
+        return false;
+    }
+
+    removeAt(*index);
+    return true;
+}
+
+void ParticleManager::removeAt(size_t index)
+{
+    // Past the limit the next step wakes everything anyway, so there is no need to keep counting
+    if (sleep_.enabled && removed_.size() <= MAX_REMOVED_WAKES)
+    {
+        const Particle particle = particles_[index];
+        removed_.push_back(RemovedParticle{particle.position(), particle.radius()});
+    }
+
+    particles_.remove(index);
+}
+
+void ParticleManager::wakeRemovedNeighbours()
+{
+    if (sleeping_ > 0 && removed_.size() > MAX_REMOVED_WAKES)
+    {
+        wakeAll(particles_);
+        sleeping_ = 0;
+    }
+    else if (sleeping_ > 0)
+    {
+        workers_.parallelFor(chunkCount(), [this](size_t chunk) {
+            const size_t first = chunk * PARTICLE_CHUNK;
+            const size_t last = std::min(first + PARTICLE_CHUNK, particles_.size());
+            for (const auto& removed : removed_)
+            {
+                wakeTouching(particles_, removed.position, removed.radius, sleep_.max_drift, first, last);
+            }
+        });
+    }
+
+    removed_.clear();
+}
+
+void ParticleManager::emitStreams(float dt)
+{
+    spawn_batch_.clear();
+    for (auto& emitter : emitters_)
+    {
+        emitter.emit(dt, random_, spawn_batch_);
+    }
+
+    spawn(spawn_batch_);
+}
+
 void ParticleManager::updateParticles(float dt)
 {
-    updateGrid();
+    PARTICLESIM_PROFILE_SCOPE(ProfileZone::Step);
+
+    if (!removed_.empty())
+    {
+        wakeRemovedNeighbours();
+    }
+
+    if (!emitters_.empty())
+    {
+        emitStreams(dt);
+    }
+
+    // Cell sizes and grid shapes are settled up front, so that every node count below is known before the run
+    prepareGrid();
+
+    const size_t chunks = chunkCount();
+    chunk_stats_.resize(chunks);
+    step_constants_ = integrationConstants(dt);
+
+    step_graph_.setCount(locate_node_, chunks);
+    step_graph_.setCount(bucket_node_, partitioners_.size());
+    step_graph_.setCount(sort_node_, sort_interval_ > 0 && step_count_ % sort_interval_ == 0 ? 1 : 0);
+    for (size_t level = 0; level < MAX_GRID_LEVELS; ++level)
+    {
+        for (int phase = 0; phase < 3; ++phase)
+        {
+            step_graph_.setCount(collision_nodes_[level][static_cast<size_t>(phase)], collisionPassSize(level, phase));
+        }
+    }
+    step_graph_.setCount(integrate_node_, chunks);
+
+    workers_.run(step_graph_);
+
+    max_overlap_ = *std::max_element(column_overlap_.begin(), column_overlap_.end());
 
-    for (auto& particle : particles_)
+    // Always merged in chunk order, so the sums do not depend on which thread finished first
+    stats_ = ParticleStats{};
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
     {
-        particle.setAcceleration(Vec2f{0, G});
-        resolveCollisions(particle);
-        particle.nextPosition(dt);
-        resolveOutOfBounds(particle);
+        stats_.merge(chunk_stats_[chunk]);
     }
+
+    if (sleep_.enabled)
+    {
+        sleeping_ = stats_.asleep;
+    }
+    ++step_count_;
+}
+
+IntegrationConstants ParticleManager::integrationConstants(float dt) const
+{
+    // The kernel applies each particle's radius to these walls itself
+    const auto& [x_bounds, y_bounds] = container_.getBounds();
+    const auto& [x_min, x_max] = x_bounds;
+    const auto& [y_min, y_max] = y_bounds;
+
+    return IntegrationConstants{dt, Vec2f{0.0f, G}, x_min, x_max, y_min, y_max};
+}
+
+void ParticleManager::integrate(float dt)
+{
+    step_constants_ = integrationConstants(dt);
+    workers_.parallelFor(chunkCount(), [this](size_t chunk) { integrateChunk(chunk); });
+}
+
+size_t ParticleManager::chunkCount() const
+{
+    return (particles_.size() + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+}
+
+void ParticleManager::integrateChunk(size_t chunk)
+{
+    PARTICLESIM_PROFILE_SCOPE(ProfileZone::Integration);
+    const size_t first = chunk * PARTICLE_CHUNK;
+    const size_t last = std::min(first + PARTICLE_CHUNK, particles_.size());
+    integrateParticles(integrationArrays(particles_), first, last, step_constants_, simd_level_);
 }
 
 void ParticleManager::updateGrid()
 {
-    // Move particles to their new regions
-    for (auto& particle : particles_)
+    prepareGrid();
+    workers_.parallelFor(chunkCount(), [this](size_t chunk) { locateChunk(chunk); });
+    workers_.parallelFor(partitioners_.size(), [this](size_t level) { partitioners_[level].finishRebuild(particles_); });
+}
+
+void ParticleManager::prepareGrid()
+{
+    // The container may have been resized or moved since the last step, through setContainer() or directly
+    if (container_.getBounds() != grid_bounds_)
+    {
+        fitContainer();
+    }
+
+    chooseCellSizes();
+
+    for (auto& grid : partitioners_)
+    {
+        grid.beginRebuild(particles_);
+    }
+}
+
+void ParticleManager::locateChunk(size_t chunk)
+{
+    // Finding a particle's cell is independent of every other particle, only the counting afterwards is not
+    const size_t first = chunk * PARTICLE_CHUNK;
+    const size_t last = std::min(first + PARTICLE_CHUNK, particles_.size());
+    if (partitioners_.size() == 1)
     {
-        partitioner_.remove(particle);
-        partitioner_.add(particle);
+        partitioners_.front().locate(particles_, first, last);
+        return;
+    }
+
+    for (size_t level = 0; level < partitioners_.size(); ++level)
+    {
+        partitioners_[level].locate(particles_, particle_level_, static_cast<uint8_t>(level), first, last);
     }
 }
 
-void ParticleManager::resolveOutOfBounds(Particle& particle)
+void ParticleManager::resolveOutOfBounds(Particle particle)
 {
     // Window Bound Checking
-    auto& pos = particle.position();
+    auto pos = particle.position();
     const float radius = particle.radius();
 
     // Container is centered, so we add/subtract half the size to get bounds
@@ -75,26 +402,119 @@ void ParticleManager::resolveOutOfBounds(Particle& particle)
     }
 
     pos.clamp({x_min, x_max}, {y_min, y_max});
+    particle.setPosition(pos);
 }
 
-void ParticleManager::resolveCollisions(Particle& particle)
+void ParticleManager::resolveCollisions()
 {
-    auto neighbours = partitioner_.getNearby(particle);
+    for (size_t level = 0; level < partitioners_.size(); ++level)
+    {
+        for (int phase = 0; phase < 3; ++phase)
+        {
+            // Two captures at most, so that std::function keeps the task inline instead of allocating it
+            const std::pair<size_t, int> pass{level, phase};
+            workers_.parallelFor(collisionPassSize(level, phase), [this, &pass](size_t i) {
+                resolveCollisionPass(pass.first, pass.second, i);
+            });
+        }
+    }
+
+    max_overlap_ = *std::max_element(column_overlap_.begin(), column_overlap_.end());
+}
+
+size_t ParticleManager::collisionPassSize(size_t level, int phase) const
+{
+    // A particle only reaches into its own grid column and the one to its left, so columns two apart never touch the
+    // same particles. Resolving all even columns in parallel and then all odd columns needs no locking, and because
+    // the work split does not depend on the thread count the result is the same no matter how many threads run it.
+    // Coarser levels also reach one column to the right, into the finer grids, so only columns three apart are
+    // independent there. Levels run one after another, coarse pairs after fine ones.
+    if (level >= partitioners_.size() || (level == 0 && phase == 2))
+    {
+        return 0;
+    }
+
+    const int stride = level == 0 ? 2 : 3;
+    return static_cast<size_t>(partitioners_[level].columns() - phase + stride - 1) / static_cast<size_t>(stride);
+}
+
+void ParticleManager::resolveCollisionPass(size_t level, int phase, size_t index)
+{
+    const int col = phase + (level == 0 ? 2 : 3) * static_cast<int>(index);
+    auto& overlap = column_overlap_[static_cast<size_t>(col)];
+    const float column_overlap = resolveCollisionsInColumn(level, col);
+
+    // The finest level covers every column and starts each step's figures afresh
+    overlap = level == 0 ? column_overlap : std::max(overlap, column_overlap);
+}
+
+float ParticleManager::maxOverlap() const
+{
+    return max_overlap_;
+}
+
+float ParticleManager::maxSpeed() const
+{
+    const auto vxs = particles_.velocityX();
+    const auto vys = particles_.velocityY();
+
+    float max_speed2 = 0.0f;
+    for (size_t i = 0; i < vxs.size(); ++i)
+    {
+        max_speed2 = std::max(max_speed2, vxs[i] * vxs[i] + vys[i] * vys[i]);
+    }
+
+    return std::sqrt(max_speed2);
+}
+
+float ParticleManager::minRadius() const
+{
+    const auto radii = particles_.radii();
+    return radii.empty() ? 0.0f : *std::min_element(radii.begin(), radii.end());
+}
 
-    for (auto nbr : neighbours)
+float ParticleManager::resolveCollisionsInColumn(size_t level, int col)
+{
+    PARTICLESIM_PROFILE_SCOPE(ProfileZone::Collisions);
+
+    // Scratch space lives as long as the manager, so a warmed up pass does not allocate
+    CollisionBlock& block = collision_blocks_[workers_.threadIndex()];
+
+    const FixedGrid& grid = partitioners_[level];
+    float max_overlap = 0.0f;
+    grid.forEachCellInColumn(col, [&](int row) {
+        const float overlap = level == 0 ? block.resolveCell(particles_, grid, row, col, sleep_)
+                                         : block.resolveCoarseCell(particles_, partitioners_, level, row, col, sleep_);
+        max_overlap = std::max(max_overlap, overlap);
+    });
+
+    return max_overlap;
+}
+
+void ParticleManager::resolveCollisions(Particle particle)
+{
+    // Only sees particles of its own size class
+    partitioners_[partitionerLevel(particle.id())].forEachNearby(particle.id(), [&](Particle::id_type nbr)
     {
-        Particle& other = particles_[nbr];
+        Particle other = particles_[nbr];
         const auto axis = particle.position() - other.position();
         const auto dist2 = vec_dot(axis, axis);
         const auto min_dist = particle.radius() + other.radius();
 
         if (dist2 > min_dist * min_dist)
         {
-            continue;
+            return;
         }
 
         const auto dist = std::sqrt(dist2);
-        Vec2f norm = axis / dist;
+        Vec2f norm{0.0f, -1.0f};
+
+        // Particles clamped into the same corner can sit exactly on top of each other, push those apart vertically
+        if (dist > 0.0f)
+        {
+            norm = axis / dist;
+        }
+
         const float delta = 0.5f * std::abs(dist - min_dist);
         particle.move(norm * delta);
         other.move(norm * -delta);
@@ -103,24 +523,221 @@ void ParticleManager::resolveCollisions(Particle& particle)
         Vec2f delta_vel = vec_dot(norm, particle.velocity() - other.velocity()) * norm;
         particle.changeVelocity(-delta_vel);
         other.changeVelocity(delta_vel);
-    }
+    });
 }
 
-const ParticleManager::ParticleStore& ParticleManager::particles() const
+const ParticleStore& ParticleManager::particles() const
 {
     return particles_;
 }
 
+ParticleStore& ParticleManager::particles()
+{
+    return particles_;
+}
+
+const FixedGrid& ParticleManager::partitioner(size_t level) const
+{
+    return partitioners_[level];
+}
+
+size_t ParticleManager::partitionerLevels() const
+{
+    return partitioners_.size();
+}
+
+size_t ParticleManager::partitionerLevel(size_t id) const
+{
+    return partitioners_.size() > 1 ? particle_level_[id] : 0;
+}
+
 size_t ParticleManager::particle_count() const
 {
     return particles_.size();
 }
 
+SimdLevel ParticleManager::simdLevel() const
+{
+    return simd_level_;
+}
+
+void ParticleManager::setSimdLevel(SimdLevel level)
+{
+    simd_level_ = level;
+}
+
+GridStorage ParticleManager::gridStorage() const
+{
+    return grid_storage_;
+}
+
+void ParticleManager::setGridStorage(GridStorage storage)
+{
+    grid_storage_ = storage;
+    resetPartitioner();
+}
+
+size_t ParticleManager::partitionerMemory() const
+{
+    size_t bytes = 0;
+    for (const auto& grid : partitioners_)
+    {
+        bytes += grid.memoryUsage();
+    }
+
+    return bytes;
+}
+
+const Container& ParticleManager::container() const
+{
+    return container_;
+}
+
+void ParticleManager::setContainer(const Vec2u& size, const Vec2f& position)
+{
+    container_.setSize(size);
+    container_.setPosition(position);
+    fitContainer();
+}
+
+void ParticleManager::fitContainer()
+{
+    resetPartitioner();
+
+    // Sleepers left hanging in the air or outside the new walls would never notice
+    wakeAll(particles_);
+    sleeping_ = 0;
+}
+
+const SleepSettings& ParticleManager::sleepSettings() const
+{
+    return sleep_;
+}
+
+void ParticleManager::setSleepSettings(const SleepSettings& settings)
+{
+    if (!settings.enabled)
+    {
+        wakeAll(particles_);
+        sleeping_ = 0;
+    }
+
+    sleep_ = settings;
+}
+
+size_t ParticleManager::sleepingCount() const
+{
+    return sleeping_;
+}
+
+const ParticleStats& ParticleManager::statistics() const
+{
+    return stats_;
+}
+
+uint64_t ParticleManager::stepCount() const
+{
+    return step_count_;
+}
+
+void ParticleManager::setStepCount(uint64_t steps)
+{
+    step_count_ = steps;
+}
+
+void ParticleManager::sortParticles()
+{
+    if (partitioners_.size() == 1)
+    {
+        particles_.permute(partitioners_.front().particlesByCell());
+    }
+    else
+    {
+        // Finest level first, each in its own cell order
+        sort_order_.clear();
+        for (const auto& grid : partitioners_)
+        {
+            const auto ids = grid.particlesByCell();
+            sort_order_.insert(sort_order_.end(), ids.begin(), ids.end());
+        }
+        particles_.permute(sort_order_);
+    }
+
+    // Every id the grid holds has just changed, bucketing again is simpler and about as cheap as renumbering
+    updateGrid();
+}
+
+size_t ParticleManager::sortInterval() const
+{
+    return sort_interval_;
+}
+
+void ParticleManager::setSortInterval(size_t interval)
+{
+    sort_interval_ = interval;
+}
+
+Random& ParticleManager::random()
+{
+    return random_;
+}
+
+uint32_t ParticleManager::seed() const
+{
+    return random_.seed();
+}
+
+void ParticleManager::setSeed(uint32_t seed)
+{
+    random_.reseed(seed);
+}
+
+uint64_t ParticleManager::stateHash() const
+{
+    // 64 bit FNV-1a over the raw bytes, so -0.0 and 0.0 or two NaN payloads count as different states
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    const uint64_t header[] = {step_count_, particles_.size(), container_.getWidth(), container_.getHeight()};
+    mix(header, sizeof(header));
+    mix(&container_.position(), sizeof(Vec2f));
+
+    for (const auto array : {particles_.positionX(), particles_.positionY(), particles_.velocityX(), particles_.velocityY(),
+                             particles_.accelerationX(), particles_.accelerationY(), particles_.radii(), particles_.masses()})
+    {
+        mix(array.data(), array.size_bytes());
+    }
+
+    // Only mixed in when sleep is on, so hashes of runs without it are unaffected by the extra arrays
+    if (sleep_.enabled)
+    {
+        for (const auto array : {particles_.awake(), particles_.anchorX(), particles_.anchorY()})
+        {
+            mix(array.data(), array.size_bytes());
+        }
+        mix(particles_.restSteps().data(), particles_.restSteps().size_bytes());
+    }
+
+    return hash;
+}
+
 void ParticleManager::clear()
 {
     particles_.clear();
-    Particle::nextID = 0;
-    partitioner_.reset();
+    removed_.clear();
+    step_count_ = 0;
+    sleeping_ = 0;
+    max_overlap_ = 0.0f;
+    stats_ = ParticleStats{};
+    cell_sizes_.assign(1, FixedGrid::DEFAULT_CELL_SIZE);
+    resetPartitioner();
+    random_.reseed(random_.seed());
 }
 
 }
@@ -1,39 +1,253 @@
 #pragma once
 #include <array>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include "common/utils.h"
+#include "collisions.h"
+#include "emitter.h"
 #include "particle.h"
+#include "particle_store.h"
 #include "fixed_grid.h"
+#include "integrator.h"
+#include "sleep.h"
+#include "statistics.h"
+#include "thread_pool.h"
 
 namespace sim {
 
 class ParticleManager
 {
 public:
-    using ParticleStore = std::vector<Particle>;
+    // A thread count of 0 uses one thread per hardware core
+    ParticleManager(Container& container, size_t thread_count = 0);
 
-    ParticleManager(Container& container);
+    // Throws std::invalid_argument unless 0 < radius <= MAX_RADIUS
+    Particle createParticleAtCursor(float x, float y, float radius = 10.0f);
 
-    const Particle& createParticleAtCursor(float x, float y);
+    // Creates every particle of the batch at once, clamped into the container like createParticleAtCursor() and to
+    // MAX_VEL like Particle::setVelocity(). The store grows once and is filled in array by array, and the grid takes the
+    // new particles in with its next rebuild.
+    // Returns the index of the first new particle. Throws std::invalid_argument, before adding anything, unless every
+    // radius satisfies 0 < radius <= MAX_RADIUS, and std::length_error if ParticleIndex would run out.
+    size_t spawn(std::span<const ParticleSpawn> batch);
 
-    void resolveOutOfBounds(Particle& particle);
-    void resolveCollisions(Particle& particle);
+    // Streams that updateParticles() runs at the start of every substep, adding their particles with spawn().
+    // Emitters that have reached their limit stay until removed. clear() keeps them.
+    std::vector<Emitter>& emitters();
+    const std::vector<Emitter>& emitters() const;
+
+    // Removes a particle in constant time by moving the last particle into its place. Handles stay valid, indices held
+    // outside the store do not, just like after sortParticles(). The grids drop it with the next rebuild, so call
+    // updateGrid() before running a stand-alone phase. Sleepers touching it wake at the start of the next step.
+    // Returns false if the handle no longer refers to a particle.
+    bool remove(ParticleHandle handle);
+
+    // Removes every particle for which pred(Particle) returns true and returns how many went. Walks the store from the
+    // back, so every particle is tested once and the particles that survive end up in the same order for any run.
+    template <typename Predicate>
+    size_t removeIf(Predicate pred);
+
+    void resolveOutOfBounds(Particle particle);
+    // Resolves one particle against its grid neighbours
+    void resolveCollisions(Particle particle);
+
+    // Resolves every overlapping pair once, working through the grid cell by cell
+    void resolveCollisions();
+
+    // Deepest overlap found by the last resolveCollisions() pass, as a fraction of the pair's combined radii
+    float maxOverlap() const;
+
+    // Largest particle speed and smallest radius in the store, 0 for both if it is empty
+    float maxSpeed() const;
+    float minRadius() const;
+    void integrate(float dt);
+
+    // One substep: grid, collisions, integration and sleep. The phases run as a single task graph on the thread pool,
+    // so each one starts on whichever threads are free the moment the one before it is done.
     void updateParticles(float dt);
     void updateGrid();
 
     const ParticleStore& particles() const;
+    ParticleStore& particles();
+
+    // Particles are bucketed into up to MAX_GRID_LEVELS grids by size, with cell sizes picked from the radii in the
+    // store on every updateGrid(). The coarsest cells fit the largest particle. A finer grid, a power of two smaller,
+    // is split off when at least three quarters of the particles above it fit into it, so a few big particles do not
+    // force big cells on many small ones. Every particle lives in the finest level its diameter fits, and pairs across
+    // levels are resolved from the coarser side. Uniform radii give a single level with cells one diameter wide, unless
+    // the scene is so sparse that would mean more than CELLS_PER_PARTICLE cells per particle. Level 0 is the finest.
+    const FixedGrid& partitioner(size_t level = 0) const;
+    size_t partitionerLevels() const;
+
+    // Level the particle was bucketed into by the last updateGrid()
+    size_t partitionerLevel(size_t id) const;
+
+    // Dense grids by default. Sparse grids only spend memory on occupied cells, for large worlds that are mostly empty.
+    // They give the same results as dense grids with the same cells, but since they never walk empty cells they drop
+    // the CELLS_PER_PARTICLE limit, so very sparse scenes get smaller cells than with dense grids.
+    GridStorage gridStorage() const;
+    void setGridStorage(GridStorage storage);
+
+    // Bytes reserved by the grids of every level
+    size_t partitionerMemory() const;
 
     size_t particle_count() const;
     void clear();
 
+    const Container& container() const;
+
+    // Moves and resizes the container. Changing the container directly, e.g. through Container::handleResize(), works
+    // too and takes effect at the next updateGrid(). Either way the grids are reshaped in place to the new bounds.
+    void setContainer(const Vec2u& size, const Vec2f& position);
+
+    // Number of updateParticles() calls since the manager was created or cleared
+    uint64_t stepCount() const;
+    void setStepCount(uint64_t steps);
+
+    // Reorders the particle store into grid cell order so that neighbours sit close together in memory. Indices change,
+    // and since pairs inside a cell are resolved in index order, later steps differ slightly from an unsorted run.
+    // A given interval still gives the same results for any thread count.
+    void sortParticles();
+
+    // Runs sortParticles() every interval steps from inside updateParticles(), 0 never sorts (the default)
+    size_t sortInterval() const;
+    void setSortInterval(size_t interval);
+
+    // Seeded random numbers for anything that spawns or perturbs particles. clear() restarts the sequence, so the
+    // same seed and the same inputs always reproduce the same run.
+    Random& random();
+    uint32_t seed() const;
+    void setSeed(uint32_t seed);
+
+    // Hash of every particle array, the container and the step count. Equal hashes mean bitwise-identical states, which
+    // holds for any thread count and SIMD level given the same seed and inputs.
+    uint64_t stateHash() const;
+
+    // Particles that stay at rest long enough are put to sleep and skipped until something wakes them, off by default.
+    // Resizing or moving the container wakes everything, as does turning sleep off.
+    const SleepSettings& sleepSettings() const;
+    void setSleepSettings(const SleepSettings& settings);
+
+    // Number of particles asleep after the last updateParticles() call
+    size_t sleepingCount() const;
+
+    // Speed, energy, momentum, bounds and occupancy of the particles as the last updateParticles() call left them,
+    // gathered during its integration pass. All zero before the first step and after clear().
+    const ParticleStats& statistics() const;
+
+    // Instruction set used by integrate(), defaults to the best one the CPU supports
+    SimdLevel simdLevel() const;
+    void setSimdLevel(SimdLevel level);
+
 private:
     using BoundsType = std::pair<Vec2f, Vec2f>;
     BoundsType getMinMaxBounds();
 
-    FixedGrid partitioner_;
+    float resolveCollisionsInColumn(size_t level, int col);
+    void resetPartitioner();
+
+    // Builds the task graph of updateParticles() once, node counts are set before every run
+    void buildStepGraph();
+
+    // Serial part of updateGrid(): refits the grids to the container, picks the cell sizes and sizes every grid
+    void prepareGrid();
+
+    // Work of a single task, shared by updateParticles() and the stand-alone phases. Particle loops run over chunks of
+    // PARTICLE_CHUNK particles, collision passes over every second or third grid column starting at phase.
+    size_t chunkCount() const;
+    void locateChunk(size_t chunk);
+    void integrateChunk(size_t chunk);
+    size_t collisionPassSize(size_t level, int phase) const;
+    void resolveCollisionPass(size_t level, int phase, size_t index);
+    IntegrationConstants integrationConstants(float dt) const;
+
+    // Runs every emitter's stream for dt seconds
+    void emitStreams(float dt);
+
+    void removeAt(size_t index);
+
+    // Wakes the sleepers that touched particles removed since the last step
+    void wakeRemovedNeighbours();
+
+    // Reshapes the grids to the container's current bounds and wakes every sleeper
+    void fitContainer();
+
+    // Picks the cell size of every level from the current radii and particle count, regridding if they changed
+    void chooseCellSizes();
+
+    static constexpr size_t MAX_GRID_LEVELS = 4;
+    static constexpr float CELLS_PER_PARTICLE = 4.0f;
+    static constexpr size_t PARTICLE_CHUNK = 4096;
+
+    // Past this many removals in a step, waking everything is cheaper than testing every sleeper against each of them
+    static constexpr size_t MAX_REMOVED_WAKES = 64;
+
+    // Cell sizes from finest to coarsest, one grid per size, and the level each particle was bucketed into
+    std::vector<float> cell_sizes_{FixedGrid::DEFAULT_CELL_SIZE};
+    std::vector<FixedGrid> partitioners_;
+    BoundsType grid_bounds_;
+    GridStorage grid_storage_{GridStorage::Dense};
+    std::vector<uint8_t> particle_level_;
+    std::vector<ParticleIndex> sort_order_;
     ParticleStore particles_;
     Container& container_;
+    ThreadPool workers_;
+    SimdLevel simd_level_{detectSimdLevel()};
+    uint64_t step_count_{0};
+    size_t sort_interval_{0};
+    SleepSettings sleep_;
+    size_t sleeping_{0};
+
+    // Locate, bucket, an optional sort, one pass per collision phase of every level and integration, each waiting for
+    // the one before. step_constants_ carries the integration settings in, chunk_stats_ the statistics of each chunk out.
+    TaskGraph step_graph_;
+    TaskGraph::NodeId locate_node_{0};
+    TaskGraph::NodeId bucket_node_{0};
+    TaskGraph::NodeId sort_node_{0};
+    std::array<std::array<TaskGraph::NodeId, 3>, MAX_GRID_LEVELS> collision_nodes_{};
+    TaskGraph::NodeId integrate_node_{0};
+    IntegrationConstants step_constants_{};
+    std::vector<ParticleStats> chunk_stats_;
+    ParticleStats stats_;
+
+    std::vector<Emitter> emitters_;
+    std::vector<ParticleSpawn> spawn_batch_;
+
+    // Where particles were removed since the last step, only kept while sleep is on
+    struct RemovedParticle
+    {
+        Vec2f position;
+        float radius;
+    };
+    std::vector<RemovedParticle> removed_;
+
+    // Collision scratch space, one block per pool thread so that stealing a column never has to warm up a new one
+    std::vector<CollisionBlock> collision_blocks_;
+
+    // Worst overlap per grid column from the last collision pass, each written by the one task that owns the column
+    std::vector<float> column_overlap_;
+    float max_overlap_{0.0f};
+    Random random_;
 };
 
+template <typename Predicate>
+size_t ParticleManager::removeIf(Predicate pred)
+{
+    // The particle moved into a gap comes from further back and has already been tested
+    size_t removed = 0;
+    for (size_t i = particles_.size(); i-- > 0;)
+    {
+        if (pred(particles_[i]))
+        {
+            removeAt(i);
+            ++removed;
+        }
+    }
+
+    return removed;
+}
+
 }
 
 namespace std {
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "particle_store.h"
+
+namespace sim {
+
+namespace {
+
+template <typename T>
+void swapRemove(std::vector<T>& array, size_t index)
+{
+    array[index] = array.back();
+    array.pop_back();
+}
+
+template <typename T>
+void permuteArray(std::vector<T>& array, std::span<const ParticleIndex> order, std::vector<T>& scratch)
+{
+    scratch.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        scratch[i] = array[order[i]];
+    }
+
+    array.swap(scratch);
+}
+
+}
+
+void ParticleStore::reserve(size_t count)
+{
+    pos_x_.reserve(count);
+    pos_y_.reserve(count);
+    vel_x_.reserve(count);
+    vel_y_.reserve(count);
+    acc_x_.reserve(count);
+    acc_y_.reserve(count);
+    radius_.reserve(count);
+    mass_.reserve(count);
+    awake_.reserve(count);
+    rest_steps_.reserve(count);
+    anchor_x_.reserve(count);
+    anchor_y_.reserve(count);
+    slot_.reserve(count);
+    slot_index_.reserve(count);
+    slot_generation_.reserve(count);
+    free_slots_.reserve(count);
+}
+
+void ParticleStore::clear()
+{
+    releaseSlots(0);
+    pos_x_.clear();
+    pos_y_.clear();
+    vel_x_.clear();
+    vel_y_.clear();
+    acc_x_.clear();
+    acc_y_.clear();
+    radius_.clear();
+    mass_.clear();
+    awake_.clear();
+    rest_steps_.clear();
+    anchor_x_.clear();
+    anchor_y_.clear();
+}
+
+void ParticleStore::assignSlots(size_t first)
+{
+    slot_.resize(size());
+    for (size_t i = first; i < size(); ++i)
+    {
+        ParticleIndex slot;
+        if (!free_slots_.empty())
+        {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+        else
+        {
+            slot = static_cast<ParticleIndex>(slot_index_.size());
+            slot_index_.push_back(0);
+            slot_generation_.push_back(1);
+        }
+
+        slot_[i] = slot;
+        slot_index_[slot] = static_cast<ParticleIndex>(i);
+    }
+}
+
+void ParticleStore::releaseSlots(size_t first)
+{
+    for (size_t i = first; i < slot_.size(); ++i)
+    {
+        ++slot_generation_[slot_[i]];
+        free_slots_.push_back(slot_[i]);
+    }
+    slot_.resize(std::min(first, slot_.size()));
+}
+
+void ParticleStore::resize(size_t count)
+{
+    if (count > max_size())
+    {
+        throw std::length_error("particle count exceeds the range of ParticleIndex, raise PARTICLESIM_INDEX_WIDTH");
+    }
+
+    const size_t previous = size();
+    releaseSlots(count);
+    pos_x_.resize(count);
+    pos_y_.resize(count);
+    vel_x_.resize(count);
+    vel_y_.resize(count);
+    acc_x_.resize(count);
+    acc_y_.resize(count);
+    radius_.resize(count);
+    mass_.resize(count);
+    awake_.resize(count, 1.0f);
+    rest_steps_.resize(count);
+    anchor_x_.resize(count);
+    anchor_y_.resize(count);
+    assignSlots(previous);
+}
+
+size_t ParticleStore::add(const Vec2f& position, float radius)
+{
+    if (size() >= max_size())
+    {
+        throw std::length_error("particle count exceeds the range of ParticleIndex, raise PARTICLESIM_INDEX_WIDTH");
+    }
+
+    pos_x_.push_back(position.x);
+    pos_y_.push_back(position.y);
+    vel_x_.push_back(0.0f);
+    vel_y_.push_back(0.0f);
+    acc_x_.push_back(0.0f);
+    acc_y_.push_back(G);
+    radius_.push_back(radius);
+    mass_.push_back(1.0f);
+    awake_.push_back(1.0f);
+    rest_steps_.push_back(0);
+    anchor_x_.push_back(position.x);
+    anchor_y_.push_back(position.y);
+    assignSlots(size() - 1);
+    return size() - 1;
+}
+
+void ParticleStore::remove(size_t index)
+{
+    const auto slot = slot_[index];
+    ++slot_generation_[slot];
+    free_slots_.push_back(slot);
+
+    for (auto* array : {&pos_x_, &pos_y_, &vel_x_, &vel_y_, &acc_x_, &acc_y_, &radius_, &mass_, &awake_, &anchor_x_, &anchor_y_})
+    {
+        swapRemove(*array, index);
+    }
+    swapRemove(rest_steps_, index);
+    swapRemove(slot_, index);
+
+    // The particle that was last now lives at index
+    if (index < size())
+    {
+        slot_index_[slot_[index]] = static_cast<ParticleIndex>(index);
+    }
+}
+
+bool ParticleStore::remove(ParticleHandle handle)
+{
+    const auto index = indexOf(handle);
+    if (!index)
+    {
+        return false;
+    }
+
+    remove(*index);
+    return true;
+}
+
+void ParticleStore::permute(std::span<const ParticleIndex> order)
+{
+    if (order.size() != size())
+    {
+        throw std::invalid_argument("a permutation must cover every particle in the store");
+    }
+
+    for (auto* array : {&pos_x_, &pos_y_, &vel_x_, &vel_y_, &acc_x_, &acc_y_, &radius_, &mass_, &awake_, &anchor_x_, &anchor_y_})
+    {
+        permuteArray(*array, order, scratch_);
+    }
+
+    permuteArray(rest_steps_, order, scratch_steps_);
+    permuteArray(slot_, order, scratch_slots_);
+    for (size_t i = 0; i < slot_.size(); ++i)
+    {
+        slot_index_[slot_[i]] = static_cast<ParticleIndex>(i);
+    }
+}
+
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "common/constants.h"
+#include "common/vector.h"
+
+// Width in bits of particle indices, set through the PARTICLESIM_INDEX_WIDTH CMake cache variable
+#ifndef PARTICLESIM_INDEX_WIDTH
+#define PARTICLESIM_INDEX_WIDTH 32
+#endif
+
+static_assert(PARTICLESIM_INDEX_WIDTH == 16 || PARTICLESIM_INDEX_WIDTH == 32 || PARTICLESIM_INDEX_WIDTH == 64,
+              "PARTICLESIM_INDEX_WIDTH must be 16, 32 or 64");
+
+namespace sim {
+
+using ParticleIndex = std::conditional_t<PARTICLESIM_INDEX_WIDTH == 16, uint16_t,
+                      std::conditional_t<PARTICLESIM_INDEX_WIDTH == 32, uint32_t, uint64_t>>;
+
+class Particle;
+class ConstParticle;
+
+// Refers to one particle for as long as it exists, whatever reordering or removal of other particles moves it around.
+// Once the particle is removed the handle stays invalid, even after its slot has been given to a new particle.
+struct ParticleHandle
+{
+    ParticleIndex slot{std::numeric_limits<ParticleIndex>::max()};
+    uint32_t generation{0};
+
+    bool operator==(const ParticleHandle&) const = default;
+};
+
+/*
+Structure-of-arrays storage for every particle in the simulation. Each attribute lives in its own contiguous array so the
+hot loops only stream the fields they actually touch. The index of a particle in the store doubles as its id.
+Particle (see particle.h) is a lightweight view into a single slot of the store, and ConstParticle the read-only view that
+a const store hands out.
+
+Indices are dense and change when particles are sorted or removed, handles do not. Every particle owns a slot in a
+table that maps slots to current indices, and each slot counts how often it has been freed. Removal moves the last
+particle into the gap and patches that particle's slot, so it costs the same however big the store is.
+*/
+class ParticleStore
+{
+public:
+    template <typename StoreType>
+    class basic_iterator
+    {
+    public:
+        using   difference_type = ptrdiff_t;
+        using        value_type = std::conditional_t<std::is_const_v<StoreType>, ConstParticle, Particle>;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator() = default;
+        basic_iterator(StoreType* store, size_t index)
+            : store_{store}
+            , index_{index}
+        {
+        }
+
+        value_type operator*() const;
+
+        basic_iterator& operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            auto copy = *this;
+            ++index_;
+            return copy;
+        }
+
+        bool operator==(const basic_iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+    private:
+        StoreType* store_{nullptr};
+        size_t index_{0};
+    };
+
+    using       iterator = basic_iterator<ParticleStore>;
+    using const_iterator = basic_iterator<const ParticleStore>;
+
+    size_t size() const
+    {
+        return pos_x_.size();
+    }
+
+    bool empty() const
+    {
+        return pos_x_.empty();
+    }
+
+    void reserve(size_t count);
+    void clear();
+
+    // Grows or shrinks every array to count particles, new particles are zeroed, apart from being awake, and must be
+    // filled in by the caller
+    void resize(size_t count);
+
+    // Appends a particle at rest and returns its index, throws std::length_error once ParticleIndex runs out
+    size_t add(const Vec2f& position, float radius);
+
+    // Removes a particle by moving the last one into its place, so only the last particle's index changes
+    void remove(size_t index);
+
+    // Removes the particle the handle refers to, returns false if it was already gone
+    bool remove(ParticleHandle handle);
+
+    ParticleHandle handle(size_t index) const
+    {
+        const auto slot = slot_[index];
+        return ParticleHandle{slot, slot_generation_[slot]};
+    }
+
+    // Current index of the particle, or nothing once it has been removed
+    std::optional<size_t> indexOf(ParticleHandle handle) const
+    {
+        if (handle.slot >= slot_index_.size() || slot_generation_[handle.slot] != handle.generation)
+        {
+            return std::nullopt;
+        }
+
+        return static_cast<size_t>(slot_index_[handle.slot]);
+    }
+
+    bool contains(ParticleHandle handle) const
+    {
+        return indexOf(handle).has_value();
+    }
+
+    // Moves the particle at order[i] into slot i for every i, order must hold each index exactly once. Every attribute
+    // lives in the store, so the particles themselves are unchanged, but any index held outside the store is stale.
+    void permute(std::span<const ParticleIndex> order);
+
+    // Largest number of particles that ParticleIndex can address
+    static constexpr size_t max_size()
+    {
+        if constexpr (sizeof(ParticleIndex) >= sizeof(size_t))
+        {
+            return std::numeric_limits<size_t>::max();
+        }
+        else
+        {
+            return static_cast<size_t>(std::numeric_limits<ParticleIndex>::max()) + 1;
+        }
+    }
+
+    Particle operator[](size_t index);
+    ConstParticle operator[](size_t index) const;
+    Particle back();
+
+    iterator begin() { return iterator{this, 0}; }
+    iterator end() { return iterator{this, size()}; }
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, size()}; }
+
+    // Raw per-attribute arrays for loops that stream over every particle
+    std::span<float> positionX() { return pos_x_; }
+    std::span<float> positionY() { return pos_y_; }
+    std::span<float> velocityX() { return vel_x_; }
+    std::span<float> velocityY() { return vel_y_; }
+    std::span<float> accelerationX() { return acc_x_; }
+    std::span<float> accelerationY() { return acc_y_; }
+    std::span<float> radii() { return radius_; }
+    std::span<float> masses() { return mass_; }
+
+    // Sleep state: awake is 1 or 0, kept as a float so the integration kernel can scale each particle's timestep by it.
+    // A particle's anchor is where it last came to rest and its rest steps count how long it has stayed there.
+    std::span<float> awake() { return awake_; }
+    std::span<uint32_t> restSteps() { return rest_steps_; }
+    std::span<float> anchorX() { return anchor_x_; }
+    std::span<float> anchorY() { return anchor_y_; }
+
+    std::span<const float> positionX() const { return pos_x_; }
+    std::span<const float> positionY() const { return pos_y_; }
+    std::span<const float> velocityX() const { return vel_x_; }
+    std::span<const float> velocityY() const { return vel_y_; }
+    std::span<const float> accelerationX() const { return acc_x_; }
+    std::span<const float> accelerationY() const { return acc_y_; }
+    std::span<const float> radii() const { return radius_; }
+    std::span<const float> masses() const { return mass_; }
+    std::span<const float> awake() const { return awake_; }
+    std::span<const uint32_t> restSteps() const { return rest_steps_; }
+    std::span<const float> anchorX() const { return anchor_x_; }
+    std::span<const float> anchorY() const { return anchor_y_; }
+
+private:
+    friend class Particle;
+    friend class ConstParticle;
+
+    // Gives particles [first, size()) slots of their own, reusing freed ones first
+    void assignSlots(size_t first);
+
+    // Frees the slots of particles [first, size()), moving their generations on
+    void releaseSlots(size_t first);
+
+    std::vector<float> pos_x_;
+    std::vector<float> pos_y_;
+    std::vector<float> vel_x_;
+    std::vector<float> vel_y_;
+    std::vector<float> acc_x_;
+    std::vector<float> acc_y_;
+    std::vector<float> radius_;
+    std::vector<float> mass_;
+    std::vector<float> awake_;
+    std::vector<uint32_t> rest_steps_;
+    std::vector<float> anchor_x_;
+    std::vector<float> anchor_y_;
+
+    // Slot of every particle, and for every slot the index of its particle and its generation. Generations start at 1,
+    // so a default constructed handle never matches, and move on whenever a slot is freed, so old handles stop matching.
+    std::vector<ParticleIndex> slot_;
+    std::vector<ParticleIndex> slot_index_;
+    std::vector<uint32_t> slot_generation_;
+    std::vector<ParticleIndex> free_slots_;
+
+    // Swapped with each array in turn by permute(), so reordering does not allocate once it has run
+    std::vector<float> scratch_;
+    std::vector<uint32_t> scratch_steps_;
+    std::vector<ParticleIndex> scratch_slots_;
+};
+
+}
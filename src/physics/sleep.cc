@@ -0,0 +1,103 @@
+#include "sleep.h"
+
+namespace sim {
+
+size_t updateSleep(ParticleStore& particles, const SleepSettings& settings)
+{
+    return updateSleep(particles, settings, 0, particles.size());
+}
+
+size_t updateSleep(ParticleStore& particles, const SleepSettings& settings, size_t first, size_t last)
+{
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto vxs = particles.velocityX();
+    const auto vys = particles.velocityY();
+    const auto awake = particles.awake();
+    const auto rest_steps = particles.restSteps();
+    const auto anchor_xs = particles.anchorX();
+    const auto anchor_ys = particles.anchorY();
+
+    const float max_speed2 = settings.max_speed * settings.max_speed;
+    const float max_drift2 = settings.max_drift * settings.max_drift;
+
+    size_t sleeping = 0;
+    for (size_t i = first; i < last; ++i)
+    {
+        if (awake[i] == 0.0f)
+        {
+            ++sleeping;
+            continue;
+        }
+
+        const float dx = xs[i] - anchor_xs[i];
+        const float dy = ys[i] - anchor_ys[i];
+        const float speed2 = vxs[i] * vxs[i] + vys[i] * vys[i];
+
+        // Measuring drift from a fixed anchor rather than per step also catches particles creeping along slowly
+        if (dx * dx + dy * dy > max_drift2 || speed2 > max_speed2)
+        {
+            anchor_xs[i] = xs[i];
+            anchor_ys[i] = ys[i];
+            rest_steps[i] = 0;
+            continue;
+        }
+
+        if (++rest_steps[i] >= settings.rest_steps)
+        {
+            awake[i] = 0.0f;
+            vxs[i] = 0.0f;
+            vys[i] = 0.0f;
+            ++sleeping;
+        }
+    }
+
+    return sleeping;
+}
+
+void wakeAll(ParticleStore& particles)
+{
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto awake = particles.awake();
+    const auto rest_steps = particles.restSteps();
+    const auto anchor_xs = particles.anchorX();
+    const auto anchor_ys = particles.anchorY();
+
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        awake[i] = 1.0f;
+        rest_steps[i] = 0;
+        anchor_xs[i] = xs[i];
+        anchor_ys[i] = ys[i];
+    }
+}
+
+void wakeTouching(ParticleStore& particles, const Vec2f& centre, float radius, float margin, size_t first, size_t last)
+{
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto radii = particles.radii();
+    const auto awake = particles.awake();
+    const auto rest_steps = particles.restSteps();
+    const auto anchor_xs = particles.anchorX();
+    const auto anchor_ys = particles.anchorY();
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const float dx = xs[i] - centre.x;
+        const float dy = ys[i] - centre.y;
+        const float reach = radius + radii[i] + margin;
+        if (awake[i] != 0.0f || dx * dx + dy * dy > reach * reach)
+        {
+            continue;
+        }
+
+        awake[i] = 1.0f;
+        rest_steps[i] = 0;
+        anchor_xs[i] = xs[i];
+        anchor_ys[i] = ys[i];
+    }
+}
+
+}
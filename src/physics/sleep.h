@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "particle_store.h"
+
+namespace sim {
+
+struct SleepSettings
+{
+    bool enabled = false;
+
+    // A particle falls asleep once it has stayed within max_drift of where it came to rest for rest_steps substeps in a
+    // row. Inside a pile, contacts keep the stored velocity jittering by tens of units per substep even when nothing
+    // visibly moves, so the drift does most of the work and max_speed only has to rule out the top of a bounce.
+    float max_speed = 150.0f;
+    float max_drift = 1.0f;
+    uint32_t rest_steps = 120;
+
+    // A sleeper wakes when a neighbour at least this fast touches it, or when it is pushed deeper than this fraction of
+    // the pair's combined radii. Gentler contacts treat it as immovable.
+    float wake_speed = 150.0f;
+    float wake_overlap = 0.25f;
+};
+
+/*
+Advances the rest counters of every awake particle by one step and puts those that have rested long enough to sleep.
+Sleeping particles have their velocity zeroed and are skipped by the integration and collision passes until a contact
+or wakeAll() wakes them. Returns the number of particles asleep afterwards.
+*/
+size_t updateSleep(ParticleStore& particles, const SleepSettings& settings);
+
+// Same for particles [first, last) only, returns the number of them asleep afterwards
+size_t updateSleep(ParticleStore& particles, const SleepSettings& settings, size_t first, size_t last);
+
+// Wakes every particle and restarts its rest counter from its current position
+void wakeAll(ParticleStore& particles);
+
+// Wakes the sleepers among particles [first, last) that come within margin of touching the circle, for when the
+// particle there is removed and whatever rested on it has to fall
+void wakeTouching(ParticleStore& particles, const Vec2f& centre, float radius, float margin, size_t first, size_t last);
+
+}
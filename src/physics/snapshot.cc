@@ -0,0 +1,227 @@
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "mapped_file.h"
+
+#include "snapshot.h"
+
+namespace sim {
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'P', 'S', 'I', 'M', 'S', 'N', 'A', 'P'};
+constexpr uint32_t VERSION = 2;
+
+// Version 1 files stop after the masses and have no sleep state, their particles load awake
+constexpr uint32_t VERSION_1_ARRAYS = 8;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t ALIGNMENT = 64;
+
+struct SnapshotHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t particle_count;
+    uint64_t step_count;
+    uint32_t container_width;
+    uint32_t container_height;
+    float container_x;
+    float container_y;
+    uint32_t array_count;
+    uint32_t array_stride;      // bytes between the starts of consecutive arrays
+    uint8_t padding[8];
+};
+
+static_assert(sizeof(SnapshotHeader) == ALIGNMENT, "the particle arrays must start on an aligned offset");
+
+// Every attribute is stored as 4 byte elements
+constexpr size_t ELEMENT_SIZE = 4;
+
+template <typename T>
+auto asBytes(std::span<T> array)
+{
+    static_assert(sizeof(T) == ELEMENT_SIZE);
+    if constexpr (std::is_const_v<T>)
+    {
+        return std::as_bytes(array);
+    }
+    else
+    {
+        return std::as_writable_bytes(array);
+    }
+}
+
+// Order of the particle arrays in the file, new attributes may only ever be appended
+template <typename Store>
+auto snapshotArrays(Store& particles)
+{
+    return std::array{
+        asBytes(particles.positionX()),
+        asBytes(particles.positionY()),
+        asBytes(particles.velocityX()),
+        asBytes(particles.velocityY()),
+        asBytes(particles.accelerationX()),
+        asBytes(particles.accelerationY()),
+        asBytes(particles.radii()),
+        asBytes(particles.masses()),
+        asBytes(particles.awake()),
+        asBytes(particles.restSteps()),
+        asBytes(particles.anchorX()),
+        asBytes(particles.anchorY())
+    };
+}
+
+// Position of the radii among the arrays above, they are checked before anything is loaded
+constexpr size_t RADIUS_ARRAY = 6;
+
+size_t arrayStride(uint64_t particle_count)
+{
+    const size_t bytes = static_cast<size_t>(particle_count) * ELEMENT_SIZE;
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+}
+
+void saveSnapshot(const std::string& path, const ParticleManager& manager)
+{
+    const auto& container = manager.container();
+    const auto arrays = snapshotArrays(manager.particles());
+
+    SnapshotHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.particle_count = manager.particle_count();
+    header.step_count = manager.stepCount();
+    header.container_width = container.getWidth();
+    header.container_height = container.getHeight();
+    header.container_x = container.position().x;
+    header.container_y = container.position().y;
+    header.array_count = static_cast<uint32_t>(arrays.size());
+
+    const size_t stride = arrayStride(header.particle_count);
+    if (stride > UINT32_MAX)
+    {
+        throw std::runtime_error("too many particles to fit in a version " + std::to_string(VERSION) + " snapshot");
+    }
+
+    header.array_stride = static_cast<uint32_t>(stride);
+
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out)
+    {
+        throw std::runtime_error("could not open " + path + " for writing");
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const std::array<char, ALIGNMENT> zeros{};
+    for (const auto& array : arrays)
+    {
+        const size_t bytes = array.size_bytes();
+        out.write(reinterpret_cast<const char*>(array.data()), static_cast<std::streamsize>(bytes));
+        out.write(zeros.data(), static_cast<std::streamsize>(header.array_stride - bytes));
+    }
+
+    if (!out.flush())
+    {
+        throw std::runtime_error("could not write " + path);
+    }
+}
+
+void loadSnapshot(const std::string& path, ParticleManager& manager)
+{
+    const MappedFile file{path};
+    const auto bytes = file.bytes();
+
+    SnapshotHeader header;
+    if (bytes.size() < sizeof(header))
+    {
+        throw std::runtime_error(path + " is too small to be a snapshot");
+    }
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    if (header.magic != MAGIC)
+    {
+        throw std::runtime_error(path + " is not a particle snapshot");
+    }
+
+    if (header.version != VERSION && header.version != 1)
+    {
+        throw std::runtime_error(path + " has unsupported snapshot version " + std::to_string(header.version));
+    }
+
+    if (header.byte_order != BYTE_ORDER_MARK)
+    {
+        throw std::runtime_error(path + " was written on a machine with a different byte order");
+    }
+
+    if (header.particle_count > ParticleStore::max_size())
+    {
+        throw std::runtime_error(path + " holds more particles than ParticleIndex can address");
+    }
+
+    // Bounds the count by the file size before any arithmetic on it can overflow
+    auto arrays = snapshotArrays(manager.particles());
+    const size_t stored_arrays = header.version == 1 ? VERSION_1_ARRAYS : arrays.size();
+    if (header.particle_count > (bytes.size() - sizeof(header)) / (stored_arrays * ELEMENT_SIZE)
+        || header.array_count < stored_arrays
+        || header.array_stride < arrayStride(header.particle_count)
+        || bytes.size() < sizeof(header) + static_cast<uint64_t>(header.array_stride) * header.array_count)
+    {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+
+    // A radius outside (0, MAX_RADIUS] or an empty container would break the grid, so such files are turned away too
+    bool valid = header.container_width > 0 && header.container_height > 0
+              && std::isfinite(header.container_x) && std::isfinite(header.container_y);
+    const std::byte* radii = bytes.data() + sizeof(header) + RADIUS_ARRAY * header.array_stride;
+    for (size_t i = 0; valid && i < header.particle_count; ++i)
+    {
+        float radius;
+        std::memcpy(&radius, radii + i * sizeof(float), sizeof(float));
+        valid = std::isfinite(radius) && radius > 0.0f && radius <= MAX_RADIUS;
+    }
+
+    if (!valid)
+    {
+        throw std::runtime_error(path + " is truncated or corrupt");
+    }
+
+    // Reserving first means running out of memory throws while the current scene is still intact
+    manager.particles().reserve(static_cast<size_t>(header.particle_count));
+
+    manager.clear();
+    manager.setContainer(Vec2u{header.container_width, header.container_height}, Vec2f{header.container_x, header.container_y});
+    manager.particles().resize(static_cast<size_t>(header.particle_count));
+    manager.setStepCount(header.step_count);
+
+    // The spans have to be fetched again now that the store has been resized. Arrays missing from older files keep
+    // the defaults resize() gave them.
+    arrays = snapshotArrays(manager.particles());
+    const std::byte* source = bytes.data() + sizeof(header);
+    for (size_t i = 0; i < stored_arrays; ++i)
+    {
+        if (!arrays[i].empty())
+        {
+            std::memcpy(arrays[i].data(), source, arrays[i].size_bytes());
+        }
+        source += header.array_stride;
+    }
+
+    // Sleepers saved by a run with sleep on would never wake in one with it off
+    if (!manager.sleepSettings().enabled)
+    {
+        wakeAll(manager.particles());
+    }
+}
+
+}
\ No newline at end of file
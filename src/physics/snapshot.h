@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+#include "particle_manager.h"
+
+namespace sim {
+
+/*
+Versioned binary snapshots of a whole simulation: every particle array including the sleep state, the container bounds
+and the step counter. The file is a fixed 64 byte header followed by one array of 4 byte elements per particle
+attribute, each padded to 64 bytes, so restoring is a straight copy out of a memory-mapped file. Version 1 files, which
+predate the sleep state, still load with every particle awake. Both functions throw std::runtime_error on failure and
+loadSnapshot leaves the manager untouched if the file is rejected.
+*/
+void saveSnapshot(const std::string& path, const ParticleManager& manager);
+void loadSnapshot(const std::string& path, ParticleManager& manager);
+
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+
+#include "statistics.h"
+
+namespace sim {
+
+void ParticleStats::collect(const ParticleStore& particles, size_t first, size_t last, const Vec2f& area_min, const Vec2f& area_max)
+{
+    if (first >= last)
+    {
+        return;
+    }
+
+    const auto xs = particles.positionX();
+    const auto ys = particles.positionY();
+    const auto vxs = particles.velocityX();
+    const auto vys = particles.velocityY();
+    const auto masses = particles.masses();
+
+    const float bins = static_cast<float>(OCCUPANCY_BINS);
+    const float bin_x = bins / std::max(area_max.x - area_min.x, 1.0f);
+    const float bin_y = bins / std::max(area_max.y - area_min.y, 1.0f);
+
+    if (count == 0)
+    {
+        bounds_min = bounds_max = Vec2f{xs[first], ys[first]};
+    }
+
+    float max_speed2 = max_speed * max_speed;
+    double speed = 0.0;
+    double energy = 0.0;
+    double momentum_x = 0.0;
+    double momentum_y = 0.0;
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const float speed2 = vxs[i] * vxs[i] + vys[i] * vys[i];
+        speed += std::sqrt(speed2);
+        max_speed2 = std::max(max_speed2, speed2);
+        energy += 0.5 * masses[i] * speed2;
+        momentum_x += static_cast<double>(masses[i]) * vxs[i];
+        momentum_y += static_cast<double>(masses[i]) * vys[i];
+
+        bounds_min.x = std::min(bounds_min.x, xs[i]);
+        bounds_min.y = std::min(bounds_min.y, ys[i]);
+        bounds_max.x = std::max(bounds_max.x, xs[i]);
+        bounds_max.y = std::max(bounds_max.y, ys[i]);
+
+        const auto col = static_cast<size_t>(std::clamp((xs[i] - area_min.x) * bin_x, 0.0f, bins - 1.0f));
+        const auto row = static_cast<size_t>(std::clamp((ys[i] - area_min.y) * bin_y, 0.0f, bins - 1.0f));
+        ++occupancy[row * OCCUPANCY_BINS + col];
+    }
+
+    count += last - first;
+    speed_sum += speed;
+    max_speed = std::sqrt(max_speed2);
+    kinetic_energy += energy;
+    momentum += Vec2d<double>{momentum_x, momentum_y};
+}
+
+void ParticleStats::merge(const ParticleStats& other)
+{
+    if (other.count == 0)
+    {
+        asleep += other.asleep;
+        return;
+    }
+
+    if (count == 0)
+    {
+        bounds_min = other.bounds_min;
+        bounds_max = other.bounds_max;
+    }
+    else
+    {
+        bounds_min = Vec2f{std::min(bounds_min.x, other.bounds_min.x), std::min(bounds_min.y, other.bounds_min.y)};
+        bounds_max = Vec2f{std::max(bounds_max.x, other.bounds_max.x), std::max(bounds_max.y, other.bounds_max.y)};
+    }
+
+    count += other.count;
+    asleep += other.asleep;
+    speed_sum += other.speed_sum;
+    max_speed = std::max(max_speed, other.max_speed);
+    kinetic_energy += other.kinetic_energy;
+    momentum += other.momentum;
+
+    for (size_t i = 0; i < occupancy.size(); ++i)
+    {
+        occupancy[i] += other.occupancy[i];
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/vector.h"
+
+#include "particle_store.h"
+
+namespace sim {
+
+/*
+Summary figures of a particle store. ParticleManager collects them chunk by chunk right after integrating each chunk,
+while its particles are still in cache, and merges the chunks in order, so the figures cost no extra sweep over memory
+and come out the same for any thread count.
+
+Mass is the per-particle mass of the store. The occupancy histogram splits the container into OCCUPANCY_BINS by
+OCCUPANCY_BINS regions, row by row from the top left, and counts the particles whose centre lies in each.
+*/
+struct ParticleStats
+{
+    static constexpr size_t OCCUPANCY_BINS = 8;
+
+    size_t count{0};
+    size_t asleep{0};
+
+    double speed_sum{0.0};
+    float max_speed{0.0f};
+    double kinetic_energy{0.0};
+    Vec2d<double> momentum{0.0, 0.0};
+
+    // Smallest box around every particle centre, both corners are 0 for an empty store
+    Vec2f bounds_min{0.0f, 0.0f};
+    Vec2f bounds_max{0.0f, 0.0f};
+
+    std::array<uint32_t, OCCUPANCY_BINS * OCCUPANCY_BINS> occupancy{};
+
+    double meanSpeed() const
+    {
+        return count > 0 ? speed_sum / static_cast<double>(count) : 0.0;
+    }
+
+    // Adds the figures of particles [first, last) to these, binning them over the region from area_min to area_max
+    void collect(const ParticleStore& particles, size_t first, size_t last, const Vec2f& area_min, const Vec2f& area_max);
+
+    // Combines the figures of two disjoint sets of particles
+    void merge(const ParticleStats& other);
+};
+
+}
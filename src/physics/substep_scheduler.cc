@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "substep_scheduler.h"
+
+namespace sim {
+
+SubstepScheduler::SubstepScheduler()
+    : SubstepScheduler{Settings{}}
+{
+}
+
+SubstepScheduler::SubstepScheduler(const Settings& settings)
+    : settings_{settings}
+{
+    if (settings_.min_substeps < 1 || settings_.max_substeps < settings_.min_substeps)
+    {
+        throw std::invalid_argument("substep bounds must satisfy 1 <= min <= max");
+    }
+
+    if (!(settings_.max_travel > 0.0f) || !(settings_.overlap_tolerance > 0.0f))
+    {
+        throw std::invalid_argument("max_travel and overlap_tolerance must be positive");
+    }
+}
+
+int SubstepScheduler::next(const ParticleManager& manager, float frame_time)
+{
+    int substeps = settings_.min_substeps;
+
+    const float min_radius = manager.minRadius();
+    if (min_radius > 0.0f)
+    {
+        const float travel = manager.maxSpeed() * frame_time;
+        const float limit = std::ceil(travel / (settings_.max_travel * min_radius));
+        substeps = std::max(substeps, static_cast<int>(std::min(limit, static_cast<float>(settings_.max_substeps))));
+    }
+
+    // Overlap feedback relative to the previous frame, ramping up quickly and backing off slowly to avoid oscillating
+    if (last_substeps_ > 0)
+    {
+        const float overlap = manager.maxOverlap();
+        if (overlap > settings_.overlap_tolerance)
+        {
+            substeps = std::max(substeps, last_substeps_ + std::max(1, last_substeps_ / 2));
+        }
+        else if (overlap > 0.5f * settings_.overlap_tolerance)
+        {
+            substeps = std::max(substeps, last_substeps_);
+        }
+        else
+        {
+            substeps = std::max(substeps, last_substeps_ - 1);
+        }
+    }
+
+    last_substeps_ = std::clamp(substeps, settings_.min_substeps, settings_.max_substeps);
+    return last_substeps_;
+}
+
+}
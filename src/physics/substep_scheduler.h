@@ -0,0 +1,48 @@
+#pragma once
+#include "particle_manager.h"
+
+namespace sim {
+
+/*
+Chooses how many substeps to split each frame into. The lower bound is a CFL-style limit: the fastest particle may only
+travel a fraction of the smallest radius per substep, so particles cannot pass through each other. On top of that the
+deepest overlap left by the last collision pass is used as feedback. Piles at rest are slow but need several
+relaxation passes per frame to stay stiff, so when overlaps grow past the tolerance the count is raised by half, and
+it only drops back by one substep per frame once overlaps are well below the tolerance.
+*/
+class SubstepScheduler
+{
+public:
+    struct Settings
+    {
+        int min_substeps = 1;
+        int max_substeps = 32;
+        float max_travel = 0.5f;            // fraction of the smallest radius the fastest particle may move per substep
+        float overlap_tolerance = 0.05f;    // deepest acceptable overlap, as a fraction of the pair's combined radii
+    };
+
+    SubstepScheduler();
+
+    // Throws std::invalid_argument unless 1 <= min_substeps <= max_substeps and both fractions are positive
+    explicit SubstepScheduler(const Settings& settings);
+
+    // Substep count for the next frame of length frame_time, within the configured bounds
+    int next(const ParticleManager& manager, float frame_time);
+
+    // Count returned by the last call to next(), 0 before the first
+    int lastSubsteps() const
+    {
+        return last_substeps_;
+    }
+
+    const Settings& settings() const
+    {
+        return settings_;
+    }
+
+private:
+    Settings settings_;
+    int last_substeps_{0};
+};
+
+}
@@ -0,0 +1,39 @@
+#include <stdexcept>
+
+#include "task_graph.h"
+
+namespace sim {
+
+TaskGraph::NodeId TaskGraph::add(std::function<void(size_t)> task, std::initializer_list<NodeId> after)
+{
+    tasks_.push_back(std::make_unique<std::function<void(size_t)>>(std::move(task)));
+    auto node = std::make_unique<TaskNode>();
+    node->task = tasks_.back().get();
+    node->unfinished = &unfinished_;
+
+    for (const auto dependency : after)
+    {
+        if (dependency >= nodes_.size())
+        {
+            throw std::invalid_argument("a task graph node can only depend on nodes added before it");
+        }
+
+        nodes_[dependency]->successors.push_back(node.get());
+        ++node->dependencies;
+    }
+
+    nodes_.push_back(std::move(node));
+    return nodes_.size() - 1;
+}
+
+void TaskGraph::setCount(NodeId node, size_t count)
+{
+    nodes_[node]->count = count;
+}
+
+size_t TaskGraph::count(NodeId node) const
+{
+    return nodes_[node]->count;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace sim {
+
+// One node of a TaskGraph, or the single node of a ThreadPool::parallelFor call
+struct TaskNode
+{
+    const std::function<void(size_t)>* task{nullptr};
+    size_t count{0};
+
+    // Nodes that wait for this one, and how many nodes this one waits for
+    std::vector<TaskNode*> successors;
+    size_t dependencies{0};
+
+    // Progress of the current run: dependencies still running, indices still running and the run's count of nodes that
+    // have not finished yet
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> remaining{0};
+    std::atomic<size_t>* unfinished{nullptr};
+};
+
+/*
+A fixed set of parallel loops and the order they must run in, built once and run by ThreadPool::run() as often as
+needed. Each node calls its task for every index in [0, count) once all the nodes it depends on have finished. Nodes that
+do not depend on each other run at the same time, and a node starts the moment its last dependency is done rather than
+when everything before it is. Counts can change between runs, a node with a count of 0 finishes straight away.
+
+Building the graph allocates, running it does not.
+*/
+class TaskGraph
+{
+public:
+    using NodeId = size_t;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Adds a node that runs after every node in after, which must have been added before it
+    NodeId add(std::function<void(size_t)> task, std::initializer_list<NodeId> after = {});
+
+    void setCount(NodeId node, size_t count);
+    size_t count(NodeId node) const;
+
+    size_t size() const
+    {
+        return nodes_.size();
+    }
+
+private:
+    friend class ThreadPool;
+
+    std::vector<std::unique_ptr<TaskNode>> nodes_;
+    std::vector<std::unique_ptr<std::function<void(size_t)>>> tasks_;
+    std::atomic<size_t> unfinished_{0};
+};
+
+}
@@ -0,0 +1,311 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace sim {
+
+namespace {
+
+// The pool a worker thread belongs to and the index of its queue
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Queue 0 belongs to whichever thread calls into the pool, every worker has its own after that
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+
+    workers_.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+        ++epoch_;
+    }
+
+    work_ready_.notify_all();
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (workers_.empty() || count == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> unfinished{1};
+    TaskNode node;
+    node.task = &task;
+    node.count = count;
+    node.unfinished = &unfinished;
+
+    const size_t queue = threadIndex();
+    ready(&node, queue);
+    helpUntilDone(unfinished, queue);
+}
+
+void ThreadPool::run(TaskGraph& graph)
+{
+    if (graph.nodes_.empty())
+    {
+        return;
+    }
+
+    // Every counter is reset before the first node is queued, workers may pick it up straight away
+    graph.unfinished_ = graph.nodes_.size();
+    for (const auto& node : graph.nodes_)
+    {
+        node->pending = node->dependencies;
+    }
+
+    const size_t queue = threadIndex();
+    for (const auto& node : graph.nodes_)
+    {
+        if (node->dependencies == 0)
+        {
+            ready(node.get(), queue);
+        }
+    }
+
+    helpUntilDone(graph.unfinished_, queue);
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    current_pool = this;
+    current_queue = index;
+
+    while (true)
+    {
+        if (!runOne(index) && !idle(nullptr))
+        {
+            return;
+        }
+    }
+}
+
+size_t ThreadPool::threadIndex() const
+{
+    return current_pool == this ? current_queue : 0;
+}
+
+bool ThreadPool::push(size_t queue, const WorkItem& item)
+{
+    WorkQueue& q = *queues_[queue];
+    {
+        std::lock_guard lock{q.mutex};
+        if (q.back - q.front == WorkQueue::CAPACITY)
+        {
+            return false;
+        }
+
+        q.items[q.back++ % WorkQueue::CAPACITY] = item;
+        q.size = q.back - q.front;
+    }
+
+    notifyWork();
+    return true;
+}
+
+bool ThreadPool::pop(size_t queue, WorkItem& item)
+{
+    WorkQueue& q = *queues_[queue];
+    if (q.size == 0)
+    {
+        return false;
+    }
+
+    std::lock_guard lock{q.mutex};
+    if (q.back == q.front)
+    {
+        return false;
+    }
+
+    item = q.items[--q.back % WorkQueue::CAPACITY];
+    q.size = q.back - q.front;
+    return true;
+}
+
+bool ThreadPool::steal(size_t thief, WorkItem& item)
+{
+    for (size_t offset = 1; offset < queues_.size(); ++offset)
+    {
+        WorkQueue& q = *queues_[(thief + offset) % queues_.size()];
+        if (q.size == 0)
+        {
+            continue;
+        }
+
+        std::lock_guard lock{q.mutex};
+        if (q.back != q.front)
+        {
+            item = q.items[q.front++ % WorkQueue::CAPACITY];
+            q.size = q.back - q.front;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::hasWork() const
+{
+    return std::any_of(queues_.begin(), queues_.end(), [](const auto& q) { return q->size > 0; });
+}
+
+bool ThreadPool::runOne(size_t queue)
+{
+    WorkItem item;
+    if (pop(queue, item) || steal(queue, item))
+    {
+        execute(item, queue);
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::execute(WorkItem item, size_t queue)
+{
+    // Hand the upper half back to the queue until one index is left, thieves take the big halves from the front
+    while (item.last - item.first > 1)
+    {
+        const size_t middle = item.first + (item.last - item.first) / 2;
+        if (!push(queue, WorkItem{item.node, middle, item.last}))
+        {
+            break;
+        }
+        item.last = middle;
+    }
+
+    for (size_t i = item.first; i < item.last; ++i)
+    {
+        (*item.node->task)(i);
+    }
+
+    const size_t ran = item.last - item.first;
+    if (item.node->remaining.fetch_sub(ran) == ran)
+    {
+        finish(item.node, queue);
+    }
+}
+
+void ThreadPool::ready(TaskNode* node, size_t queue)
+{
+    node->remaining = node->count;
+    if (node->count == 0)
+    {
+        finish(node, queue);
+        return;
+    }
+
+    const WorkItem item{node, 0, node->count};
+    if (!push(queue, item))
+    {
+        execute(item, queue);
+    }
+}
+
+void ThreadPool::finish(TaskNode* node, size_t queue)
+{
+    for (auto* successor : node->successors)
+    {
+        if (successor->pending.fetch_sub(1) == 1)
+        {
+            ready(successor, queue);
+        }
+    }
+
+    // The last node of a run wakes whoever is waiting for it
+    if (node->unfinished->fetch_sub(1) == 1)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            ++epoch_;
+        }
+        work_ready_.notify_all();
+    }
+}
+
+void ThreadPool::helpUntilDone(const std::atomic<size_t>& unfinished, size_t queue)
+{
+    while (unfinished > 0)
+    {
+        if (!runOne(queue))
+        {
+            idle(&unfinished);
+        }
+    }
+}
+
+bool ThreadPool::idle(const std::atomic<size_t>* unfinished)
+{
+    // Phases of a step follow each other within microseconds, so look around for a while before going to sleep
+    for (int spin = 0; spin < IDLE_SPINS; ++spin)
+    {
+        if (hasWork() || (unfinished && *unfinished == 0))
+        {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock lock{mutex_};
+    const size_t epoch = epoch_;
+    ++sleepers_;
+
+    // Pairs with the fence in notifyWork(): either the pusher sees this sleeper, or this check sees the new work
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!stopping_ && !hasWork() && !(unfinished && *unfinished == 0))
+    {
+        work_ready_.wait(lock, [&] { return epoch_ != epoch; });
+    }
+
+    --sleepers_;
+    return !stopping_;
+}
+
+void ThreadPool::notifyWork()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_ > 0)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            ++epoch_;
+        }
+        work_ready_.notify_one();
+    }
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "task_graph.h"
+
+namespace sim {
+
+/*
+A fixed set of worker threads that stay alive for the lifetime of the pool, so that the simulation can fan work out every
+substep without paying for thread creation. The thread calling parallelFor or run always takes part in the work.
+
+Work is balanced by stealing. Every thread keeps its own queue of index ranges: it takes a range from the back of its
+queue, splits off the upper half back onto the queue until a single index is left, and runs that. A thread whose queue
+runs dry takes the oldest, and so biggest, range from the front of another thread's queue. Dense parts of the scene thus
+keep every thread busy without any up-front guess about how the work is spread. Waiting threads keep taking work, so
+tasks may call parallelFor or run themselves.
+*/
+class ThreadPool
+{
+public:
+    // A thread count of 0 uses one thread per hardware core
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Total number of threads doing work, including the caller
+    size_t size() const
+    {
+        return workers_.size() + 1;
+    }
+
+    // Calls task(i) for every i in [0, count) and blocks until all of them have returned
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // Runs every node of the graph once, in dependency order, and blocks until all of them have finished
+    void run(TaskGraph& graph);
+
+    // Index in [0, size()) of the calling thread. Threads outside the pool count as 0, like the caller of a run.
+    size_t threadIndex() const;
+
+private:
+    struct WorkItem
+    {
+        TaskNode* node;
+        size_t first;
+        size_t last;
+    };
+
+    // Ranges are split in halves, so a queue holds a few dozen items at most. When one is full the owner runs the range
+    // itself instead of splitting it further.
+    struct alignas(64) WorkQueue
+    {
+        static constexpr size_t CAPACITY = 256;
+
+        std::mutex mutex;
+        std::array<WorkItem, CAPACITY> items;
+        size_t front{0};
+        size_t back{0};
+        std::atomic<size_t> size{0};
+    };
+
+    void workerLoop(size_t index);
+
+    bool push(size_t queue, const WorkItem& item);
+    bool pop(size_t queue, WorkItem& item);
+    bool steal(size_t thief, WorkItem& item);
+    bool hasWork() const;
+
+    // Runs one item from the thread's own queue or a stolen one, returns false if there was none
+    bool runOne(size_t queue);
+    void execute(WorkItem item, size_t queue);
+
+    // Queues a node whose dependencies have all finished, and finishes a node whose indices have all run
+    void ready(TaskNode* node, size_t queue);
+    void finish(TaskNode* node, size_t queue);
+
+    // Keeps running work until unfinished drops to 0
+    void helpUntilDone(const std::atomic<size_t>& unfinished, size_t queue);
+
+    // Waits for new work or for unfinished to drop to 0, returns false once the pool is stopping
+    bool idle(const std::atomic<size_t>* unfinished);
+    void notifyWork();
+
+private:
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+
+    // Idle threads sleep on work_ready_ until epoch_ moves on. sleepers_ lets pushes skip the mutex while nobody sleeps.
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    size_t epoch_{0};
+    std::atomic<size_t> sleepers_{0};
+    bool stopping_{false};
+
+    static constexpr int IDLE_SPINS = 64;
+};
+
+}
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "trajectory.h"
+
+namespace sim {
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'P', 'S', 'I', 'M', 'T', 'R', 'A', 'J'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Fixed point steps per pixel and per pixel/second, fine enough that replay error stays far below a pixel
+constexpr float POSITION_SCALE = 256.0f;
+constexpr float VELOCITY_SCALE = 64.0f;
+
+// A chunk is closed after this many frames or bytes, whichever comes first
+constexpr uint32_t CHUNK_FRAMES = 64;
+constexpr size_t CHUNK_BYTES = 4 << 20;
+
+constexpr size_t STREAM_COUNT = 5;
+
+struct FileHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t byte_order;
+    float position_scale;
+    float velocity_scale;
+    uint32_t chunk_frames;
+    uint32_t padding;
+};
+
+struct ChunkHeader
+{
+    uint32_t frame_count;
+    uint32_t padding;
+    uint64_t byte_count;
+};
+
+struct FrameHeader
+{
+    uint64_t step;
+    uint64_t particle_count;
+    uint32_t container_width;
+    uint32_t container_height;
+    float container_x;
+    float container_y;
+};
+
+// Order of the streams within a frame
+template <typename Frame>
+auto frameStreams(Frame& frame)
+{
+    return std::array{&frame.pos_x, &frame.pos_y, &frame.vel_x, &frame.vel_y, &frame.radius};
+}
+
+float streamScale(size_t stream, float position_scale, float velocity_scale)
+{
+    return stream == 2 || stream == 3 ? velocity_scale : position_scale;
+}
+
+int32_t quantize(float value, float scale)
+{
+    const double scaled = std::nearbyint(static_cast<double>(value) * scale);
+    if (std::isnan(scaled))
+    {
+        return 0;
+    }
+
+    constexpr auto lowest = static_cast<double>(std::numeric_limits<int32_t>::min());
+    constexpr auto highest = static_cast<double>(std::numeric_limits<int32_t>::max());
+    return static_cast<int32_t>(std::clamp(scaled, lowest, highest));
+}
+
+void appendVarint(std::vector<uint8_t>& out, int64_t value)
+{
+    // Zigzag first so small negative deltas stay short too
+    auto bits = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (bits >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(bits | 0x80));
+        bits >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(bits));
+}
+
+template <typename T>
+void appendRaw(std::vector<uint8_t>& out, const T& value)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+}
+
+void TrajectoryFrame::capture(const ParticleStore& particles, const Container& source, uint64_t step_count)
+{
+    step = step_count;
+    container = source;
+    pos_x.assign(particles.positionX().begin(), particles.positionX().end());
+    pos_y.assign(particles.positionY().begin(), particles.positionY().end());
+    vel_x.assign(particles.velocityX().begin(), particles.velocityX().end());
+    vel_y.assign(particles.velocityY().begin(), particles.velocityY().end());
+    radius.assign(particles.radii().begin(), particles.radii().end());
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string& path, size_t max_queued_frames)
+    : path_{path}
+    , out_{path, std::ios::binary | std::ios::trunc}
+    , max_queued_frames_{std::max<size_t>(1, max_queued_frames)}
+{
+    if (!out_)
+    {
+        throw std::runtime_error("could not open " + path + " for writing");
+    }
+
+    FileHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.position_scale = POSITION_SCALE;
+    header.velocity_scale = VELOCITY_SCALE;
+    header.chunk_frames = CHUNK_FRAMES;
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writer_ = std::thread{[this] { run(); }};
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    try
+    {
+        finish();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+void TrajectoryRecorder::record(const ParticleStore& particles, const Container& container, uint64_t step)
+{
+    std::unique_lock lock{mutex_};
+    frame_released_.wait(lock, [this] { return queue_.size() < max_queued_frames_ || !error_.empty(); });
+
+    if (!error_.empty())
+    {
+        throw std::runtime_error(error_);
+    }
+
+    if (stopping_)
+    {
+        throw std::runtime_error("recording to " + path_ + " has already finished");
+    }
+
+    TrajectoryFrame frame;
+    if (!free_frames_.empty())
+    {
+        frame = std::move(free_frames_.back());
+        free_frames_.pop_back();
+    }
+
+    lock.unlock();
+    frame.capture(particles, container, step);
+    lock.lock();
+
+    queue_.push_back(std::move(frame));
+    frame_queued_.notify_one();
+}
+
+void TrajectoryRecorder::finish()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+
+    frame_queued_.notify_all();
+    if (writer_.joinable())
+    {
+        writer_.join();
+        out_.close();
+    }
+
+    if (!error_.empty())
+    {
+        throw std::runtime_error(error_);
+    }
+}
+
+void TrajectoryRecorder::run()
+{
+    std::unique_lock lock{mutex_};
+    while (true)
+    {
+        frame_queued_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+        if (queue_.empty())
+        {
+            break;
+        }
+
+        TrajectoryFrame frame = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        try
+        {
+            encode(frame);
+        }
+        catch (const std::exception& e)
+        {
+            lock.lock();
+            error_ = e.what();
+            queue_.clear();
+            frame_released_.notify_all();
+            return;
+        }
+
+        lock.lock();
+        free_frames_.push_back(std::move(frame));
+        frame_released_.notify_one();
+    }
+
+    lock.unlock();
+
+    try
+    {
+        flushChunk();
+    }
+    catch (const std::exception& e)
+    {
+        lock.lock();
+        error_ = e.what();
+    }
+}
+
+void TrajectoryRecorder::encode(const TrajectoryFrame& frame)
+{
+    const size_t count = frame.particle_count();
+
+    FrameHeader header{};
+    header.step = frame.step;
+    header.particle_count = count;
+    header.container_width = frame.container.getWidth();
+    header.container_height = frame.container.getHeight();
+    header.container_x = frame.container.position().x;
+    header.container_y = frame.container.position().y;
+    appendRaw(chunk_, header);
+
+    const auto streams = frameStreams(frame);
+    for (size_t s = 0; s < STREAM_COUNT; ++s)
+    {
+        const std::vector<float>& values = *streams[s];
+        const float scale = streamScale(s, POSITION_SCALE, VELOCITY_SCALE);
+
+        // Particles that did not exist last frame are encoded against zero
+        auto& previous = previous_[s];
+        previous.resize(count, 0);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int32_t quantized = quantize(values[i], scale);
+            appendVarint(chunk_, static_cast<int64_t>(quantized) - previous[i]);
+            previous[i] = quantized;
+        }
+    }
+
+    if (++chunk_frames_ == CHUNK_FRAMES || chunk_.size() >= CHUNK_BYTES)
+    {
+        flushChunk();
+    }
+}
+
+void TrajectoryRecorder::flushChunk()
+{
+    if (chunk_frames_ > 0)
+    {
+        ChunkHeader header{};
+        header.frame_count = chunk_frames_;
+        header.byte_count = chunk_.size();
+
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out_.write(reinterpret_cast<const char*>(chunk_.data()), static_cast<std::streamsize>(chunk_.size()));
+        out_.flush();
+    }
+
+    if (!out_)
+    {
+        throw std::runtime_error("could not write " + path_);
+    }
+
+    chunk_.clear();
+    chunk_frames_ = 0;
+    for (auto& previous : previous_)
+    {
+        previous.clear();
+    }
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& path)
+    : path_{path}
+    , file_{path}
+{
+    const auto bytes = file_.bytes();
+
+    FileHeader header;
+    if (bytes.size() < sizeof(header))
+    {
+        throw std::runtime_error(path + " is too small to be a trajectory");
+    }
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    if (header.magic != MAGIC)
+    {
+        throw std::runtime_error(path + " is not a particle trajectory");
+    }
+
+    if (header.version != VERSION)
+    {
+        throw std::runtime_error(path + " has unsupported trajectory version " + std::to_string(header.version));
+    }
+
+    if (header.byte_order != BYTE_ORDER_MARK)
+    {
+        throw std::runtime_error(path + " was written on a machine with a different byte order");
+    }
+
+    position_scale_ = header.position_scale;
+    velocity_scale_ = header.velocity_scale;
+    rewind();
+}
+
+void TrajectoryReader::rewind()
+{
+    offset_ = sizeof(FileHeader);
+    chunk_end_ = offset_;
+    chunk_frames_left_ = 0;
+}
+
+bool TrajectoryReader::beginChunk()
+{
+    const auto bytes = file_.bytes();
+
+    ChunkHeader header;
+    if (bytes.size() - offset_ < sizeof(header))
+    {
+        return false;
+    }
+
+    std::memcpy(&header, bytes.data() + offset_, sizeof(header));
+    if (header.byte_count > bytes.size() - offset_ - sizeof(header))
+    {
+        return false;
+    }
+
+    offset_ += sizeof(header);
+    chunk_end_ = offset_ + static_cast<size_t>(header.byte_count);
+    chunk_frames_left_ = header.frame_count;
+
+    for (auto& previous : previous_)
+    {
+        previous.clear();
+    }
+
+    return true;
+}
+
+bool TrajectoryReader::next(TrajectoryFrame& frame)
+{
+    while (chunk_frames_left_ == 0)
+    {
+        if (offset_ != chunk_end_)
+        {
+            throw std::runtime_error(path_ + " has trailing bytes in a chunk");
+        }
+
+        if (!beginChunk())
+        {
+            return false;
+        }
+    }
+
+    const std::byte* data = file_.bytes().data();
+
+    FrameHeader header;
+    if (chunk_end_ - offset_ < sizeof(header))
+    {
+        throw std::runtime_error(path_ + " has a truncated frame");
+    }
+
+    std::memcpy(&header, data + offset_, sizeof(header));
+    offset_ += sizeof(header);
+
+    // Every value takes at least one byte, which bounds the count before anything is allocated
+    if (header.particle_count > (chunk_end_ - offset_) / STREAM_COUNT)
+    {
+        throw std::runtime_error(path_ + " has a corrupt frame");
+    }
+
+    const auto count = static_cast<size_t>(header.particle_count);
+
+    frame.step = header.step;
+    frame.container = Container{header.container_width, header.container_height};
+    frame.container.setPosition(Vec2f{header.container_x, header.container_y});
+
+    const auto streams = frameStreams(frame);
+    for (size_t s = 0; s < STREAM_COUNT; ++s)
+    {
+        std::vector<float>& values = *streams[s];
+        const float resolution = 1.0f / streamScale(s, position_scale_, velocity_scale_);
+
+        auto& previous = previous_[s];
+        previous.resize(count, 0);
+        values.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t bits = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                if (offset_ == chunk_end_ || shift > 63)
+                {
+                    throw std::runtime_error(path_ + " has a corrupt frame");
+                }
+
+                const auto byte = static_cast<uint8_t>(data[offset_++]);
+                bits |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    break;
+                }
+            }
+
+            const auto delta = static_cast<int64_t>(bits >> 1) ^ -static_cast<int64_t>(bits & 1);
+            previous[i] = static_cast<int32_t>(previous[i] + delta);
+            values[i] = static_cast<float>(previous[i]) * resolution;
+        }
+    }
+
+    --chunk_frames_left_;
+    return true;
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "container.h"
+#include "mapped_file.h"
+#include "particle_store.h"
+
+namespace sim {
+
+// One recorded frame, as handed to the writer thread and as decoded again on replay
+struct TrajectoryFrame
+{
+    uint64_t step{0};
+    Container container{0u, 0u};
+
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> vel_x;
+    std::vector<float> vel_y;
+    std::vector<float> radius;
+
+    void capture(const ParticleStore& particles, const Container& source, uint64_t step_count);
+
+    size_t particle_count() const
+    {
+        return pos_x.size();
+    }
+};
+
+/*
+Streams every recorded frame to disk. Positions, velocities and radii are quantised to fixed point and stored as the
+zigzag varint difference from the same particle in the previous frame, which for a settling pile is mostly one or two
+bytes per value. Frames are grouped into chunks that start from an implicit all zero frame, so every chunk can be
+decoded on its own.
+
+record() only copies the particle arrays into a recycled frame, quantising, encoding and writing all happen on a
+background thread. If the disk cannot keep up for long enough to fill the queue, record() waits for a free slot rather
+than dropping frames or growing without bound. Throws std::runtime_error if the file cannot be written.
+*/
+class TrajectoryRecorder
+{
+public:
+    explicit TrajectoryRecorder(const std::string& path, size_t max_queued_frames = 8);
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    void record(const ParticleStore& particles, const Container& container, uint64_t step);
+
+    // Writes out everything still queued and closes the file, called by the destructor if not before
+    void finish();
+
+private:
+    void run();
+    void encode(const TrajectoryFrame& frame);
+    void flushChunk();
+
+private:
+    std::string path_;
+    std::ofstream out_;
+    const size_t max_queued_frames_;
+
+    std::mutex mutex_;
+    std::condition_variable frame_queued_;
+    std::condition_variable frame_released_;
+    std::deque<TrajectoryFrame> queue_;
+    std::vector<TrajectoryFrame> free_frames_;
+    bool stopping_{false};
+    std::string error_;
+
+    // Writer thread only
+    std::vector<uint8_t> chunk_;
+    uint32_t chunk_frames_{0};
+    std::vector<int32_t> previous_[5];
+
+    std::thread writer_;
+};
+
+/*
+Plays back a file written by TrajectoryRecorder. The file is memory mapped and decoded one frame at a time. A chunk
+cut short by a crash ends the recording, anything else malformed throws std::runtime_error.
+*/
+class TrajectoryReader
+{
+public:
+    explicit TrajectoryReader(const std::string& path);
+
+    // Decodes the next frame into frame, reusing its capacity. Returns false once the recording has ended.
+    bool next(TrajectoryFrame& frame);
+    void rewind();
+
+private:
+    bool beginChunk();
+
+private:
+    std::string path_;
+    MappedFile file_;
+    float position_scale_{1.0f};
+    float velocity_scale_{1.0f};
+
+    size_t offset_{0};
+    size_t chunk_end_{0};
+    uint32_t chunk_frames_left_{0};
+    std::vector<int32_t> previous_[5];
+};
+
+}
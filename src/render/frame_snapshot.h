@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "common/profiler.h"
+#include "physics/container.h"
+#include "physics/particle_store.h"
+#include "physics/statistics.h"
+
+namespace sim {
+
+// A copy of everything the renderer needs for one frame, so drawing never has to touch live simulation state
+struct FrameSnapshot
+{
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> radius;
+    Container container{0u, 0u};
+
+    uint64_t frame{0};
+    int substeps{0};
+
+    // Statistics of the frame's last substep, gathered by the simulation while it stepped
+    ParticleStats stats;
+
+    // Physics zones and counters of this frame, in builds with profiling
+    FrameProfile profile;
+
+    // Copies the particle arrays, reusing the vectors' existing capacity
+    void capture(const ParticleStore& particles, const Container& source)
+    {
+        pos_x.assign(particles.positionX().begin(), particles.positionX().end());
+        pos_y.assign(particles.positionY().begin(), particles.positionY().end());
+        radius.assign(particles.radii().begin(), particles.radii().end());
+        container = source;
+    }
+
+    size_t particle_count() const
+    {
+        return pos_x.size();
+    }
+};
+
+}
\ No newline at end of file
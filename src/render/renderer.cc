@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <array>
+
+#include "sfml_conversions.h"
+
 #include "renderer.h"
 
 namespace sim {
@@ -5,29 +10,138 @@ namespace sim {
 Renderer::Renderer(sf::RenderWindow& window)
         : window_{window}
 {
+    createCircleTexture();
+}
+
+void Renderer::createCircleTexture()
+{
+    // A white anti-aliased disc, tinted per particle through the vertex colour
+    constexpr float half = CIRCLE_TEXTURE_SIZE / 2.0f;
+    sf::Image image;
+    image.create(CIRCLE_TEXTURE_SIZE, CIRCLE_TEXTURE_SIZE, sf::Color::Transparent);
+
+    for (unsigned int y = 0; y < CIRCLE_TEXTURE_SIZE; ++y)
+    {
+        for (unsigned int x = 0; x < CIRCLE_TEXTURE_SIZE; ++x)
+        {
+            const Vec2f offset{x + 0.5f - half, y + 0.5f - half};
+            const float coverage = std::clamp(half - offset.magnitude(), 0.0f, 1.0f);
+            image.setPixel(x, y, sf::Color{255, 255, 255, static_cast<sf::Uint8>(coverage * 255.0f)});
+        }
+    }
+
+    circle_texture_.loadFromImage(image);
+    circle_texture_.setSmooth(true);
 }
 
-void Renderer::drawParticle(const Particle& particle)
+void Renderer::drawParticle(ConstParticle particle)
 {
     sf::CircleShape shape{particle.radius()};
     shape.setOrigin({particle.radius(), particle.radius()});
-    shape.setPosition(particle.position());
+    shape.setPosition(toSfml(particle.position()));
     shape.setFillColor(sf::Color::Cyan);
     window_.draw(shape);
 }
 
+void Renderer::drawParticles(const ParticleStore& particles)
+{
+    drawParticles(particles.positionX(), particles.positionY(), particles.radii());
+}
+
+void Renderer::drawParticles(const FrameSnapshot& snapshot)
+{
+    drawParticles(snapshot.pos_x, snapshot.pos_y, snapshot.radius);
+}
+
+void Renderer::drawParticles(std::span<const float> xs, std::span<const float> ys, std::span<const float> radii)
+{
+    const size_t count = xs.size();
+    const size_t prepared = particle_vertices_.getVertexCount();
+    particle_vertices_.resize(4 * count);
+
+    // Texture coordinates and colours never change, so only fill them in for newly added quads
+    constexpr float tex_size = static_cast<float>(CIRCLE_TEXTURE_SIZE);
+    for (size_t v = prepared; v < particle_vertices_.getVertexCount(); v += 4)
+    {
+        particle_vertices_[v + 0].texCoords = {0.0f, 0.0f};
+        particle_vertices_[v + 1].texCoords = {tex_size, 0.0f};
+        particle_vertices_[v + 2].texCoords = {tex_size, tex_size};
+        particle_vertices_[v + 3].texCoords = {0.0f, tex_size};
+
+        for (size_t corner = 0; corner < 4; ++corner)
+        {
+            particle_vertices_[v + corner].color = sf::Color::Cyan;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float x = xs[i];
+        const float y = ys[i];
+        const float r = radii[i];
+        sf::Vertex* quad = &particle_vertices_[4 * i];
+
+        quad[0].position = {x - r, y - r};
+        quad[1].position = {x + r, y - r};
+        quad[2].position = {x + r, y + r};
+        quad[3].position = {x - r, y + r};
+    }
+
+    window_.draw(particle_vertices_, sf::RenderStates{&circle_texture_});
+}
+
 void Renderer::drawContainer(const Container& container)
 {
     const Vec2f c_size = Vec2f::from(container.getSize());
-    sf::RectangleShape c_shape{c_size};
+    sf::RectangleShape c_shape{toSfml(c_size)};
     Vec2f c_center = c_size / 2.0f;
 
-    c_shape.setOrigin(c_center);
-    c_shape.setPosition(container.position());
+    c_shape.setOrigin(toSfml(c_center));
+    c_shape.setPosition(toSfml(container.position()));
     c_shape.setFillColor(sf::Color::Transparent);
     c_shape.setOutlineThickness(2.0f);
 
     window_.draw(c_shape);
 }
 
+void Renderer::drawProfile(const FrameProfile& profile)
+{
+    constexpr float left = 10.0f;
+    constexpr float top = 10.0f;
+    constexpr float bar_height = 10.0f;
+    constexpr float row = 14.0f;
+    constexpr float max_width = 2.0f * PROFILE_BUDGET_MS * PROFILE_PIXELS_PER_MS;
+    constexpr float height = row * static_cast<float>(PROFILE_ZONES + 1);
+
+    // Frame first, then step, grid, collisions, integration, draw and present
+    const std::array<sf::Color, PROFILE_ZONES + 1> colors{sf::Color{220, 220, 220}, sf::Color{120, 160, 255}, sf::Color{255, 200, 60},
+                                                          sf::Color{255, 90, 90}, sf::Color{90, 220, 120}, sf::Color{200, 120, 255},
+                                                          sf::Color{140, 140, 140}};
+
+    profile_vertices_.clear();
+    addBar(left - 4.0f, top - 4.0f, max_width + 8.0f, height + 4.0f, sf::Color{0, 0, 0, 160});
+
+    auto bar = [&](size_t index, double ms) {
+        const float width = std::min(static_cast<float>(ms) * PROFILE_PIXELS_PER_MS, max_width);
+        addBar(left, top + row * static_cast<float>(index), width, bar_height, colors[index]);
+    };
+
+    bar(0, static_cast<double>(profile.frame_ns) * 1e-6);
+    for (size_t i = 0; i < PROFILE_ZONES; ++i)
+    {
+        bar(i + 1, profile.milliseconds(static_cast<ProfileZone>(i)));
+    }
+
+    addBar(left + PROFILE_BUDGET_MS * PROFILE_PIXELS_PER_MS, top - 4.0f, 1.0f, height + 4.0f, sf::Color::White);
+    window_.draw(profile_vertices_);
+}
+
+void Renderer::addBar(float x, float y, float width, float height, const sf::Color& color)
+{
+    profile_vertices_.append(sf::Vertex{{x, y}, color, {}});
+    profile_vertices_.append(sf::Vertex{{x + width, y}, color, {}});
+    profile_vertices_.append(sf::Vertex{{x + width, y + height}, color, {}});
+    profile_vertices_.append(sf::Vertex{{x, y + height}, color, {}});
+}
+
 }
\ No newline at end of file
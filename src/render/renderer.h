@@ -1,7 +1,11 @@
 #pragma once
+#include <span>
 #include <SFML/Graphics.hpp>
+#include "common/profiler.h"
 #include "physics/particle.h"
 
+#include "frame_snapshot.h"
+
 namespace sim {
 
 class Renderer
@@ -9,11 +13,33 @@ class Renderer
 public:
     Renderer(sf::RenderWindow& window);
 
-    void drawParticle(const Particle& particle);
+    void drawParticle(ConstParticle particle);
+    void drawParticles(const ParticleStore& particles);
+    void drawParticles(const FrameSnapshot& snapshot);
+    void drawParticles(std::span<const float> xs, std::span<const float> ys, std::span<const float> radii);
     void drawContainer(const Container& container);
 
+    // Bar chart of a frame profile in the top left corner: the whole frame first, then one bar per ProfileZone in
+    // declaration order, against a marker at the 60 fps budget of 16.7 ms. Bars stop at twice the budget.
+    void drawProfile(const FrameProfile& profile);
+
 private:
+    void createCircleTexture();
+    void addBar(float x, float y, float width, float height, const sf::Color& color);
+
     sf::RenderWindow& window_;
+
+    // One textured quad per particle, kept between frames so that only positions are rewritten
+    sf::VertexArray particle_vertices_{sf::Quads};
+    sf::Texture circle_texture_;
+
+    // Rebuilt every frame the overlay is shown, keeping its capacity
+    sf::VertexArray profile_vertices_{sf::Quads};
+
+    static constexpr unsigned int CIRCLE_TEXTURE_SIZE = 64;
+
+    static constexpr float PROFILE_PIXELS_PER_MS = 24.0f;
+    static constexpr float PROFILE_BUDGET_MS = 1000.0f / 60.0f;
 };
 
 }
\ No newline at end of file
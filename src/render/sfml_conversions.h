@@ -0,0 +1,21 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+
+#include "common/vector.h"
+
+namespace sim {
+
+// The physics core has no SFML dependency, these convert its vectors at the rendering boundary
+template <typename T>
+sf::Vector2<T> toSfml(const Vec2d<T>& vec)
+{
+    return sf::Vector2<T>{vec.x, vec.y};
+}
+
+template <typename T>
+Vec2d<T> fromSfml(const sf::Vector2<T>& vec)
+{
+    return Vec2d<T>{vec.x, vec.y};
+}
+
+}
\ No newline at end of file